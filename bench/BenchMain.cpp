@@ -0,0 +1,497 @@
+// Headless frame time benchmark: renders a synthetic scene into offscreen
+// targets for a fixed number of frames and prints the results as JSON.
+//
+//   hamon_bench --frames 1000 --draws 500 --triangles 2000 --textures 8 --out result.json
+//
+// --math times the SIMD math kernels against glm instead, --frames runs over
+// --objects objects each, no device needed.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Renderer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "ApiCounters.h"
+#include "StartupTimeline.h"
+#include "MathBench.h"
+// after every header that pulls in vulkan.h, the loader source is not
+// guarded against a second inclusion
+#define GLAD_VULKAN_IMPLEMENTATION
+#include "vulkan.h"
+
+struct BenchOptions {
+    uint32_t frames = 1000;
+    uint32_t warmupFrames = 100;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    bool meshlets = false;
+    // fixed step unless --realtime, so runs render identical frames
+    bool realTime = false;
+    // count Vulkan calls per frame, adds a timer around each counted call
+    bool apiCounters = false;
+    // fail the run if a measured frame allocates through operator new
+    bool assertNoAllocations = false;
+    // --texture-budget in MB, 0 is unlimited
+    VkDeviceSize textureBudget = 0;
+    uint32_t framesInFlight = 2;
+    bool math = false;
+    uint32_t mathObjects = 10000;
+    const char* output = nullptr;
+    SyntheticSceneDesc scene;
+};
+
+struct SampleSummary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+struct RenderTarget {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+};
+
+static void printUsage()
+{
+    fprintf(stderr,
+        "usage: hamon_bench [--frames N] [--warmup N] [--draws N] [--triangles N]\n"
+        "                   [--textures N] [--width N] [--height N] [--meshlets] [--realtime]\n"
+        "                   [--api-counters] [--assert-no-allocs] [--texture-budget MB]\n"
+        "                   [--frames-in-flight N] [--materials N] [--out FILE]\n"
+        "       hamon_bench --math [--frames N] [--objects N] [--out FILE]\n");
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+    options.scene.drawCount = 100;
+    options.scene.trianglesPerDraw = 1000;
+    options.scene.textureCount = 4;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--meshlets") == 0) {
+            options.meshlets = true;
+            continue;
+        }
+        if (strcmp(arg, "--realtime") == 0) {
+            options.realTime = true;
+            continue;
+        }
+        if (strcmp(arg, "--api-counters") == 0) {
+            options.apiCounters = true;
+            continue;
+        }
+        if (strcmp(arg, "--assert-no-allocs") == 0) {
+            options.assertNoAllocations = true;
+            continue;
+        }
+        if (strcmp(arg, "--math") == 0) {
+            options.math = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+        uint32_t number = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        if (strcmp(arg, "--out") == 0) {
+            options.output = value;
+        } else if (strcmp(arg, "--frames") == 0) {
+            options.frames = number;
+        } else if (strcmp(arg, "--warmup") == 0) {
+            options.warmupFrames = number;
+        } else if (strcmp(arg, "--draws") == 0) {
+            options.scene.drawCount = number;
+        } else if (strcmp(arg, "--triangles") == 0) {
+            options.scene.trianglesPerDraw = number;
+        } else if (strcmp(arg, "--textures") == 0) {
+            options.scene.textureCount = number;
+        } else if (strcmp(arg, "--width") == 0) {
+            options.width = number;
+        } else if (strcmp(arg, "--height") == 0) {
+            options.height = number;
+        } else if (strcmp(arg, "--texture-budget") == 0) {
+            options.textureBudget = VkDeviceSize(number) * 1024 * 1024;
+        } else if (strcmp(arg, "--frames-in-flight") == 0) {
+            options.framesInFlight = number;
+        } else if (strcmp(arg, "--materials") == 0) {
+            options.scene.materialCount = number;
+        } else if (strcmp(arg, "--objects") == 0) {
+            options.mathObjects = number;
+        } else {
+            return false;
+        }
+    }
+    // descriptor pool holds 1024 sets, one per (frame slot, texture)
+    const uint32_t maxTextures = 1024 / MAX_FRAMES_IN_FLIGHT;
+    if (options.frames == 0 || options.scene.drawCount == 0 ||
+        options.scene.trianglesPerDraw == 0 || options.scene.textureCount == 0 ||
+        options.scene.textureCount > maxTextures || options.scene.materialCount == 0 ||
+        options.width == 0 || options.height == 0 ||
+        options.framesInFlight == 0 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT ||
+        options.mathObjects == 0) {
+        return false;
+    }
+    return true;
+}
+
+static SampleSummary summarize(std::vector<double> samples)
+{
+    SampleSummary summary;
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    // nearest rank
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+    summary.mean = sum / samples.size();
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.min = samples.front();
+    summary.max = samples.back();
+    return summary;
+}
+
+static void writeSummary(FILE* file, const char* name, const SampleSummary& summary, size_t count, bool last)
+{
+    fprintf(file,
+        "  \"%s\": {\"samples\": %zu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+        "\"p99\": %.4f, \"min\": %.4f, \"max\": %.4f}%s\n",
+        name, count, summary.mean, summary.p50, summary.p95, summary.p99,
+        summary.min, summary.max, last ? "" : ",");
+}
+
+// text from the driver, may hold quotes, backslashes or control characters
+static void writeJsonString(FILE* file, const char* text)
+{
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; ++c) {
+        unsigned char ch = static_cast<unsigned char>(*c);
+        if (ch == '"' || ch == '\\') {
+            fputc('\\', file);
+            fputc(ch, file);
+        }
+        else if (ch < 0x20) {
+            fprintf(file, "\\u%04x", ch);
+        }
+        else {
+            fputc(ch, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static VkInstance createHeadlessInstance()
+{
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pNext = nullptr;
+    appInfo.pApplicationName = "hamon_bench";
+    appInfo.applicationVersion = VK_MAKE_VERSION(0,1,0);
+    appInfo.pEngineName = nullptr;
+    appInfo.engineVersion = VK_MAKE_VERSION(0,1,0);
+    // 1.3 entry points (vkCmdPipelineBarrier2) are used when the device has them
+    appInfo.apiVersion = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pNext = nullptr;
+    instanceInfo.pApplicationInfo = &appInfo;
+    VkInstance instance{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateInstance(&instanceInfo, hostAllocator(), &instance));
+    return instance;
+}
+
+static RenderTarget createRenderTarget(VkDevice device,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height)
+{
+    RenderTarget target = {};
+    target.image = createImage2D(device, format,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        width, height, 1, 1);
+    target.memory = createImageMemory(device, target.image, memoryProperties,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK(vkBindImageMemory(device, target.image, target.memory, 0));
+    target.view = createImageView2D(device, target.image, VK_IMAGE_ASPECT_COLOR_BIT, format);
+    return target;
+}
+
+static double findFrameScope(const GpuProfiler& profiler)
+{
+    for (const GpuScopeResult& result : profiler.results()) {
+        if (result.depth == 0 && strcmp(result.name, "frame") == 0) {
+            return result.milliseconds;
+        }
+    }
+    return -1.0;
+}
+
+int main(int argc, char** argv)
+{
+    beginStartup();
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    if (options.math) {
+        FILE* file = options.output != nullptr ? fopen(options.output, "w") : stdout;
+        if (file == nullptr) {
+            fprintf(stderr, "can't open %s\n", options.output);
+            return EXIT_FAILURE;
+        }
+        bool passed = runMathBench(file, options.mathObjects, options.frames);
+        if (file != stdout) {
+            fclose(file);
+        }
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!gladLoaderLoadVulkan(NULL, NULL, NULL)) {
+        fprintf(stderr, "failed to load vulkan\n");
+        return EXIT_FAILURE;
+    }
+    HAMON_TRACE_THREAD_NAME("main");
+
+    VkInstance instance = createHeadlessInstance();
+    VkPhysicalDevice physicalDevice = getPhysicalDevice(instance);
+    gladLoaderLoadVulkan(instance, physicalDevice, VK_NULL_HANDLE);
+
+    uint32_t graphicsQueueFamilyIndex = UINT32_MAX;
+    uint32_t presentQueueFamilyIndex = UINT32_MAX;
+    DeviceCapabilities capabilities;
+    VkDevice device = createDevice(physicalDevice, VK_NULL_HANDLE,
+        graphicsQueueFamilyIndex, presentQueueFamilyIndex, &capabilities);
+    gladLoaderLoadVulkan(instance, physicalDevice, device);
+    if (options.apiCounters) {
+        installApiCallCounters();
+    }
+    VkQueue graphicsQueue{VK_NULL_HANDLE};
+    vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    ThreadPool threadPool;
+    RendererContext context;
+    context.device_ = device;
+    context.extent_ = {options.width, options.height};
+    context.format_ = VK_FORMAT_R8G8B8A8_UNORM;
+    context.graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+    context.graphicsQueue_ = graphicsQueue;
+    context.physicalDevice_ = physicalDevice;
+    context.swapchain_ = VK_NULL_HANDLE;
+    context.commandPool_ = createCommandPool(device, graphicsQueueFamilyIndex);
+    context.descriptorPool_ = createDescriptorPool(device);
+    context.capabilities_ = capabilities;
+    context.threadPool_ = &threadPool;
+    context.meshletRendering_ = options.meshlets;
+    context.gpuProfiling_ = true;
+    context.syntheticScene_ = options.scene;
+    context.clockMode_ = options.realTime ? ClockMode::RealTime : ClockMode::FixedStep;
+    context.textureMemoryBudget_ = options.textureBudget;
+    context.framesInFlight_ = options.framesInFlight;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &context.memoryProperties_);
+
+    // one offscreen target per frame slot, like a swapchain with as many images
+    std::vector<RenderTarget> targets;
+    for (uint32_t i = 0; i < options.framesInFlight; ++i) {
+        targets.push_back(createRenderTarget(device, context.memoryProperties_,
+            context.format_, options.width, options.height));
+        context.imageViews_.push_back(targets.back().view);
+        context.images_.push_back(targets.back().image);
+    }
+
+    Renderer renderer(context);
+    renderer.init("../vert.spv", "../frag.spv");
+    // measure the material permutations, not their fallback
+    while (renderer.pipelineCache().pendingCount() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (uint32_t i = 0; i < options.warmupFrames; ++i) {
+        renderer.render();
+    }
+
+    resetApiCallCounters();
+
+    std::vector<double> cpuFrameMs;
+    std::vector<double> gpuFrameMs;
+    cpuFrameMs.reserve(options.frames);
+    gpuFrameMs.reserve(options.frames);
+    uint64_t frameAllocations = 0;
+    uint64_t maxFrameAllocations = 0;
+    uint32_t allocatingFrames = 0;
+    uint64_t lastGpuFrame = renderer.gpuProfiler().resultFrameIndex();
+    auto benchStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < options.frames; ++i) {
+        auto frameStart = std::chrono::steady_clock::now();
+        renderer.render();
+        auto frameEnd = std::chrono::steady_clock::now();
+        cpuFrameMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        if (renderer.lastFrameAllocations() != 0) {
+            frameAllocations += renderer.lastFrameAllocations();
+            maxFrameAllocations = std::max(maxFrameAllocations, renderer.lastFrameAllocations());
+            allocatingFrames++;
+        }
+
+        // GPU results lag a few frames behind, take each completed frame once
+        const GpuProfiler& profiler = renderer.gpuProfiler();
+        if (profiler.resultFrameIndex() != lastGpuFrame) {
+            lastGpuFrame = profiler.resultFrameIndex();
+            double gpuMs = findFrameScope(profiler);
+            if (gpuMs >= 0.0) {
+                gpuFrameMs.push_back(gpuMs);
+            }
+        }
+    }
+    vkDeviceWaitIdle(device);
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - benchStart).count();
+    uint64_t apiCallFrames = apiCallFrameCount();
+    std::vector<ApiCallStats> apiCalls(totalApiCalls(), totalApiCalls() + API_CALL_COUNT);
+    uninstallApiCallCounters();
+    HostAllocationStats hostStats = hostAllocationStats();
+    MemoryStats memoryStats = renderer.memoryStats();
+    memoryStats.updateBudget();
+    const TextureResidency& residency = renderer.textureResidency();
+    uint32_t partialTextures = 0;
+    for (uint32_t i = 0; i < residency.textureCount(); ++i) {
+        if (residency.residentMip(i) != 0) {
+            ++partialTextures;
+        }
+    }
+    VkDeviceSize textureResidentBytes = residency.residentBytes();
+    uint64_t textureStreamedBytes = residency.streamedBytes();
+    uint32_t pipelineCount = renderer.pipelineCache().pipelineCount();
+
+    renderer.shutdown();
+    for (const RenderTarget& target : targets) {
+        vkDestroyImageView(device, target.view, hostAllocator());
+        vkDestroyImage(device, target.image, hostAllocator());
+        vkFreeMemory(device, target.memory, hostAllocator());
+    }
+    vkDestroyDevice(device, hostAllocator());
+    vkDestroyInstance(instance, hostAllocator());
+
+    FILE* file = stdout;
+    if (options.output != nullptr) {
+        file = fopen(options.output, "w");
+        if (file == nullptr) {
+            fprintf(stderr, "can't open %s\n", options.output);
+            return EXIT_FAILURE;
+        }
+    }
+    double framesPerSecond = options.frames / totalSeconds;
+    double drawsPerFrame = options.scene.drawCount;
+    double trianglesPerFrame = drawsPerFrame * options.scene.trianglesPerDraw;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"device\": ");
+    writeJsonString(file, properties.deviceName);
+    fprintf(file, ",\n");
+    fprintf(file, "  \"timeToFirstFrameMs\": %.2f,\n", timeToFirstFrameMs());
+    fprintf(file, "  \"config\": {\"frames\": %u, \"warmupFrames\": %u, \"width\": %u, \"height\": %u, "
+        "\"framesInFlight\": %u, \"draws\": %u, \"trianglesPerDraw\": %u, \"textures\": %u, "
+        "\"materials\": %u, \"meshlets\": %s, \"realTime\": %s},\n",
+        options.frames, options.warmupFrames, options.width, options.height, options.framesInFlight,
+        options.scene.drawCount, options.scene.trianglesPerDraw, options.scene.textureCount,
+        options.scene.materialCount,
+        options.meshlets ? "true" : "false",
+        options.realTime ? "true" : "false");
+    writeSummary(file, "cpuFrameMs", summarize(cpuFrameMs), cpuFrameMs.size(), false);
+    writeSummary(file, "gpuFrameMs", summarize(gpuFrameMs), gpuFrameMs.size(), false);
+    if (options.apiCounters && apiCallFrames > 0) {
+        // per frame averages over the measured frames
+        fprintf(file, "  \"apiCallsPerFrame\": {");
+        bool first = true;
+        for (uint32_t i = 0; i < API_CALL_COUNT; ++i) {
+            if (apiCalls[i].calls == 0) {
+                continue;
+            }
+            fprintf(file, "%s\n    \"%s\": {\"calls\": %.2f, \"microseconds\": %.3f}",
+                first ? "" : ",", apiCallName(static_cast<ApiCall>(i)),
+                double(apiCalls[i].calls) / apiCallFrames,
+                apiCalls[i].nanoseconds * 1e-3 / apiCallFrames);
+            first = false;
+        }
+        fprintf(file, "\n  },\n");
+    }
+    fprintf(file, "  \"deviceMemory\": {\"categories\": {");
+    bool firstCategory = true;
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        const MemoryCategoryStats& category = memoryStats.category(static_cast<MemoryCategory>(i));
+        if (category.peakBytes == 0) {
+            continue;
+        }
+        fprintf(file, "%s\"%s\": {\"bytes\": %llu, \"peakBytes\": %llu, \"allocations\": %u}",
+            firstCategory ? "" : ", ",
+            memoryCategoryName(static_cast<MemoryCategory>(i)),
+            (unsigned long long)category.bytes,
+            (unsigned long long)category.peakBytes,
+            category.allocations);
+        firstCategory = false;
+    }
+    fprintf(file, "}, \"driverBudget\": %s, \"heaps\": [", memoryStats.driverBudget() ? "true" : "false");
+    for (uint32_t i = 0; i < memoryStats.heapCount(); ++i) {
+        const MemoryHeapStats& heap = memoryStats.heap(i);
+        fprintf(file, "%s{\"size\": %llu, \"deviceLocal\": %s, \"allocated\": %llu, \"usage\": %llu, \"budget\": %llu}",
+            i == 0 ? "" : ", ",
+            (unsigned long long)heap.size,
+            (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false",
+            (unsigned long long)heap.allocatedBytes,
+            (unsigned long long)heap.usage,
+            (unsigned long long)heap.budget);
+    }
+    fprintf(file, "]},\n");
+    fprintf(file, "  \"textures\": {\"budget\": %llu, \"residentBytes\": %llu, \"streamedBytes\": %llu, "
+        "\"withoutTopMips\": %u},\n",
+        (unsigned long long)options.textureBudget,
+        (unsigned long long)textureResidentBytes,
+        (unsigned long long)textureStreamedBytes,
+        partialTextures);
+    fprintf(file, "  \"pipelines\": %u,\n", pipelineCount);
+    if (hostAllocator() != nullptr) {
+        // driver host memory through our callbacks, live at the end of the run
+        fprintf(file, "  \"hostAllocations\": {");
+        for (uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; ++i) {
+            fprintf(file, "\"%s\": {\"bytes\": %llu, \"peakBytes\": %llu, \"internalBytes\": %llu}, ",
+                hostAllocationScopeName(i),
+                (unsigned long long)hostStats.bytes[i],
+                (unsigned long long)hostStats.peakBytes[i],
+                (unsigned long long)hostStats.internalBytes[i]);
+        }
+        fprintf(file, "\"poolBytes\": %llu, \"largeBytes\": %llu},\n",
+            (unsigned long long)hostStats.poolBytes, (unsigned long long)hostStats.largeBytes);
+    }
+    fprintf(file, "  \"allocations\": {\"total\": %llu, \"maxPerFrame\": %llu, \"framesWithAllocations\": %u},\n",
+        (unsigned long long)frameAllocations, (unsigned long long)maxFrameAllocations, allocatingFrames);
+    fprintf(file, "  \"throughput\": {\"framesPerSecond\": %.2f, \"drawsPerSecond\": %.1f, "
+        "\"trianglesPerSecond\": %.1f}\n",
+        framesPerSecond, framesPerSecond * drawsPerFrame, framesPerSecond * trianglesPerFrame);
+    fprintf(file, "}\n");
+    if (file != stdout) {
+        fclose(file);
+    }
+    if (options.assertNoAllocations && allocatingFrames != 0) {
+        fprintf(stderr, "%u of %u measured frames allocated, %llu allocations at most\n",
+            allocatingFrames, options.frames, (unsigned long long)maxFrameAllocations);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,273 @@
+#include "MathBench.h"
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Scene.h"
+#include "Meshlet.h"
+#include "SimdMath.h"
+
+// largest difference to glm a kernel may have, relative to the magnitude of
+// the values (which stay below ~100)
+static const float MAX_ERROR = 1e-3f;
+// spheres closer than this to a plane may be culled either way
+static const float SPHERE_PLANE_EPSILON = 1e-4f;
+
+struct KernelResult {
+    const char* name;
+    double glmNsPerObject;
+    double simdNsPerObject;
+    float maxError;
+    // objects the kernel classified differently from glm, for kernels
+    // that classify instead of computing values
+    uint32_t mismatches;
+};
+
+// scene-like inputs, the same for every run
+struct MathInputs {
+    std::vector<glm::mat4> matrices;
+    std::vector<Aabb> bounds;
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<glm::vec4> spheres;
+    std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    std::vector<glm::quat> rotations;
+    std::vector<float> quatX, quatY, quatZ, quatW;
+    glm::mat4 viewProj;
+    glm::vec4 frustumPlanes[6];
+};
+
+static MathInputs createInputs(uint32_t count)
+{
+    MathInputs inputs;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(-50.f, 50.f);
+    std::uniform_real_distribution<float> size(0.1f, 4.f);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::quat rotation(unit(random) + 2.f, unit(random), unit(random), unit(random));
+        rotation = glm::normalize(rotation);
+        float scale = size(random);
+        glm::mat4 matrix = glm::mat4_cast(rotation);
+        for (int column = 0; column < 3; ++column) {
+            matrix[column] *= scale;
+        }
+        matrix[3] = glm::vec4(position(random), position(random), position(random), 1.f);
+        inputs.matrices.push_back(matrix);
+        inputs.rotations.push_back(rotation);
+        inputs.quatX.push_back(rotation.x);
+        inputs.quatY.push_back(rotation.y);
+        inputs.quatZ.push_back(rotation.z);
+        inputs.quatW.push_back(rotation.w);
+
+        glm::vec3 center(unit(random), unit(random), unit(random));
+        glm::vec3 extent(size(random), size(random), size(random));
+        Aabb aabb;
+        aabb.min = center - extent;
+        aabb.max = center + extent;
+        inputs.bounds.push_back(aabb);
+        inputs.minX.push_back(aabb.min.x);
+        inputs.minY.push_back(aabb.min.y);
+        inputs.minZ.push_back(aabb.min.z);
+        inputs.maxX.push_back(aabb.max.x);
+        inputs.maxY.push_back(aabb.max.y);
+        inputs.maxZ.push_back(aabb.max.z);
+
+        glm::vec4 sphere(position(random), position(random), position(random), size(random));
+        inputs.spheres.push_back(sphere);
+        inputs.sphereX.push_back(sphere.x);
+        inputs.sphereY.push_back(sphere.y);
+        inputs.sphereZ.push_back(sphere.z);
+        inputs.sphereRadius.push_back(sphere.w);
+    }
+    // about half of the spheres are in view
+    glm::mat4 proj = glm::perspective(glm::radians(90.f), 16.f / 9.f, 0.1f, 60.f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 0.f, 10.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    inputs.viewProj = proj * view;
+    extractFrustumPlanes(inputs.viewProj, inputs.frustumPlanes);
+    return inputs;
+}
+
+// best of iterations, in nanoseconds per object
+template<typename F>
+static double timeKernel(uint32_t iterations, uint32_t count, F kernel)
+{
+    double best = 1e30;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+    return best / count;
+}
+
+static float matrixError(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b)
+{
+    float error = 0.f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                error = std::max(error, fabsf(a[i][column][row] - b[i][column][row]));
+            }
+        }
+    }
+    return error;
+}
+
+bool runMathBench(FILE* file, uint32_t objectCount, uint32_t iterations)
+{
+    MathInputs inputs = createInputs(objectCount);
+    std::vector<KernelResult> results;
+
+    {
+        std::vector<glm::mat4> reference(objectCount);
+        std::vector<glm::mat4> batch(objectCount);
+        KernelResult result = {"multiplyMatrices"};
+        result.glmNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                reference[i] = inputs.viewProj * inputs.matrices[i];
+            }
+        });
+        result.simdNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            multiplyMatrices(inputs.viewProj, inputs.matrices.data(), objectCount, batch.data());
+        });
+        result.maxError = matrixError(reference, batch);
+        results.push_back(result);
+    }
+
+    {
+        std::vector<Aabb> reference(objectCount);
+        std::vector<float> minX(objectCount), minY(objectCount), minZ(objectCount);
+        std::vector<float> maxX(objectCount), maxY(objectCount), maxZ(objectCount);
+        AabbArrays local = {inputs.minX.data(), inputs.minY.data(), inputs.minZ.data(),
+            inputs.maxX.data(), inputs.maxY.data(), inputs.maxZ.data()};
+        AabbArrays world = {minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data()};
+        KernelResult result = {"transformAabbs"};
+        result.glmNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                reference[i] = transformAabb(inputs.matrices[i], inputs.bounds[i]);
+            }
+        });
+        result.simdNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            transformAabbs(inputs.matrices.data(), local, objectCount, world);
+        });
+        result.maxError = 0.f;
+        for (uint32_t i = 0; i < objectCount; ++i) {
+            const Aabb& aabb = reference[i];
+            result.maxError = std::max({result.maxError,
+                fabsf(aabb.min.x - minX[i]), fabsf(aabb.min.y - minY[i]), fabsf(aabb.min.z - minZ[i]),
+                fabsf(aabb.max.x - maxX[i]), fabsf(aabb.max.y - maxY[i]), fabsf(aabb.max.z - maxZ[i])});
+        }
+        results.push_back(result);
+    }
+
+    {
+        std::vector<uint32_t> reference(objectCount);
+        std::vector<uint32_t> batch(objectCount);
+        size_t referenceCount = 0;
+        size_t batchCount = 0;
+        SphereArrays spheres = {inputs.sphereX.data(), inputs.sphereY.data(),
+            inputs.sphereZ.data(), inputs.sphereRadius.data()};
+        KernelResult result = {"cullSpheres"};
+        result.glmNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            referenceCount = 0;
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                const glm::vec4& sphere = inputs.spheres[i];
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; ++p) {
+                    const glm::vec4& plane = inputs.frustumPlanes[p];
+                    inside = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w >= -sphere.w;
+                }
+                if (inside) {
+                    reference[referenceCount++] = i;
+                }
+            }
+        });
+        result.simdNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            batchCount = cullSpheres(inputs.frustumPlanes, spheres, objectCount, batch.data());
+        });
+        // Both lists are ascending. A sphere only one of them has is an error
+        // unless it touches a plane within rounding, those may land on either
+        // side with FMA.
+        auto onPlane = [&](uint32_t i) {
+            const glm::vec4& sphere = inputs.spheres[i];
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4& plane = inputs.frustumPlanes[p];
+                float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w;
+                if (fabsf(distance) <= SPHERE_PLANE_EPSILON) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        uint32_t mismatches = 0;
+        size_t r = 0;
+        size_t b = 0;
+        while (r < referenceCount || b < batchCount) {
+            if (r < referenceCount && b < batchCount && reference[r] == batch[b]) {
+                ++r;
+                ++b;
+                continue;
+            }
+            uint32_t only = 0;
+            if (b == batchCount || (r < referenceCount && reference[r] < batch[b])) {
+                only = reference[r++];
+            }
+            else {
+                only = batch[b++];
+            }
+            if (!onPlane(only)) {
+                ++mismatches;
+            }
+        }
+        result.maxError = 0.f;
+        result.mismatches = mismatches;
+        results.push_back(result);
+    }
+
+    {
+        std::vector<glm::mat4> reference(objectCount);
+        std::vector<glm::mat4> batch(objectCount);
+        QuatArrays rotations = {inputs.quatX.data(), inputs.quatY.data(),
+            inputs.quatZ.data(), inputs.quatW.data()};
+        KernelResult result = {"quatsToMatrices"};
+        result.glmNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                reference[i] = glm::mat4_cast(inputs.rotations[i]);
+            }
+        });
+        result.simdNsPerObject = timeKernel(iterations, objectCount, [&]() {
+            quatsToMatrices(rotations, objectCount, batch.data());
+        });
+        result.maxError = matrixError(reference, batch);
+        results.push_back(result);
+    }
+
+    bool passed = true;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"backend\": \"%s\",\n", simdMathBackend());
+    fprintf(file, "  \"width\": %u,\n", simdMathWidth());
+    fprintf(file, "  \"config\": {\"objects\": %u, \"iterations\": %u},\n", objectCount, iterations);
+    fprintf(file, "  \"kernels\": {");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const KernelResult& result = results[i];
+        fprintf(file, "%s\n    \"%s\": {\"glmNsPerObject\": %.3f, \"simdNsPerObject\": %.3f, "
+            "\"speedup\": %.2f, \"maxError\": %g, \"mismatches\": %u}",
+            i == 0 ? "" : ",", result.name, result.glmNsPerObject, result.simdNsPerObject,
+            result.glmNsPerObject / result.simdNsPerObject, result.maxError, result.mismatches);
+        if (result.maxError > MAX_ERROR) {
+            fprintf(stderr, "%s differs from glm by %g\n", result.name, result.maxError);
+            passed = false;
+        }
+        if (result.mismatches != 0) {
+            fprintf(stderr, "%s disagrees with glm on %u objects\n", result.name, result.mismatches);
+            passed = false;
+        }
+    }
+    fprintf(file, "\n  }\n");
+    fprintf(file, "}\n");
+    return passed;
+}
@@ -0,0 +1,10 @@
+#ifndef HAMON_MATH_BENCH_H__
+#define HAMON_MATH_BENCH_H__
+#include <stdint.h>
+#include <stdio.h>
+
+// CPU only: times each SimdMath kernel against the per object glm code it
+// replaces over objectCount objects, best of iterations runs, and writes
+// the results as JSON. Returns false if a kernel disagrees with glm.
+bool runMathBench(FILE* file, uint32_t objectCount, uint32_t iterations);
+#endif
@@ -1,11 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-}ubo;
+// permutation, see Material.h
+layout(constant_id = 0) const bool HAS_TEXTURE = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+
+layout(push_constant) uniform DrawConstants {
+    mat4 mvp;
+} draw;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -15,7 +17,7 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
-    fragTexCoord = inTexCoord;
-}
\ No newline at end of file
+    gl_Position = draw.mvp * vec4(inPosition, 1.0);
+    fragColor = VERTEX_COLOR ? inColor : vec3(1.0);
+    fragTexCoord = HAS_TEXTURE ? inTexCoord : vec2(0.0);
+}
@@ -0,0 +1,191 @@
+#include "AllocationCounter.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#if HAMON_TRACK_ALLOCATIONS
+
+namespace {
+
+std::atomic<uint64_t> allocationCount(0);
+std::atomic<uint64_t> freeCount(0);
+std::atomic<uint64_t> allocatedBytes(0);
+
+void* countedAllocate(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size != 0 ? size : 1);
+}
+
+void countedFree(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+    free(ptr);
+}
+
+#if __cpp_aligned_new
+void* countedAllocateAligned(size_t size, size_t alignment)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    size = size != 0 ? size : 1;
+#ifdef _MSC_VER
+    return _aligned_malloc(size, alignment);
+#else
+    // posix_memalign wants at least pointer alignment
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) != 0) {
+        return nullptr;
+    }
+    return ptr;
+#endif
+}
+
+void countedFreeAligned(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+    freeCount.fetch_add(1, std::memory_order_relaxed);
+#ifdef _MSC_VER
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+#endif
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    void* ptr = countedAllocate(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    countedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    countedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    countedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    countedFree(ptr);
+}
+
+#if __cpp_aligned_new
+// over-aligned types (alignas above the default new alignment) come here
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    void* ptr = countedAllocateAligned(size, static_cast<size_t>(alignment));
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return countedAllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    countedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    countedFreeAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    countedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    countedFreeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    countedFreeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    countedFreeAligned(ptr);
+}
+#endif
+
+AllocationStats allocationStats()
+{
+    AllocationStats stats;
+    stats.allocations = allocationCount.load(std::memory_order_relaxed);
+    stats.frees = freeCount.load(std::memory_order_relaxed);
+    stats.bytes = allocatedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else
+
+AllocationStats allocationStats()
+{
+    return AllocationStats{0, 0, 0};
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HAMON_ALLOCATION_COUNTER_H__
+#define HAMON_ALLOCATION_COUNTER_H__
+#include <stdint.h>
+
+// Counts heap allocations of every thread through replacements of the global
+// operator new / delete. On by default in debug builds, hamon_bench always
+// has it. Allocations that bypass operator new (malloc, the Vulkan driver)
+// aren't seen.
+
+#ifndef HAMON_TRACK_ALLOCATIONS
+#ifdef NDEBUG
+#define HAMON_TRACK_ALLOCATIONS 0
+#else
+#define HAMON_TRACK_ALLOCATIONS 1
+#endif
+#endif
+
+struct AllocationStats {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+};
+
+// totals since process start, all zero when tracking is compiled out
+AllocationStats allocationStats();
+
+inline bool allocationTrackingEnabled() { return HAMON_TRACK_ALLOCATIONS != 0; }
+
+#endif
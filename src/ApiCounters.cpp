@@ -0,0 +1,304 @@
+#include "ApiCounters.h"
+#include "vulkan.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+struct ApiCallCounter {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> nanoseconds;
+};
+
+// current frame, written from any recording thread
+ApiCallCounter currentFrame[API_CALL_COUNT];
+ApiCallStats lastFrame[API_CALL_COUNT];
+ApiCallStats totals[API_CALL_COUNT];
+uint64_t frameCount = 0;
+bool installed = false;
+
+const char* const API_CALL_NAMES[API_CALL_COUNT] = {
+    "vkUpdateDescriptorSets",
+    "vkMapMemory",
+    "vkAllocateMemory",
+    "vkQueueSubmit",
+    "vkQueueSubmit2",
+    "vkCmdDraw",
+    "vkCmdDrawIndexed",
+    "vkCmdDrawIndirect",
+    "vkCmdDrawIndexedIndirect",
+    "vkCmdPipelineBarrier",
+    "vkCmdPipelineBarrier2",
+};
+
+class ApiCallTimer {
+public:
+    explicit ApiCallTimer(ApiCall call)
+        : call_(call)
+        , start_(std::chrono::steady_clock::now())
+    {
+    }
+    ~ApiCallTimer()
+    {
+        uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+        currentFrame[call_].calls.fetch_add(1, std::memory_order_relaxed);
+        currentFrame[call_].nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+    }
+private:
+    ApiCall call_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+void GLAD_API_PTR countedUpdateDescriptorSets(VkDevice device,
+    uint32_t descriptorWriteCount,
+    const VkWriteDescriptorSet* pDescriptorWrites,
+    uint32_t descriptorCopyCount,
+    const VkCopyDescriptorSet* pDescriptorCopies)
+{
+    ApiCallTimer timer(API_CALL_UPDATE_DESCRIPTOR_SETS);
+    glad_vkUpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites,
+        descriptorCopyCount, pDescriptorCopies);
+}
+
+VkResult GLAD_API_PTR countedMapMemory(VkDevice device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    VkMemoryMapFlags flags,
+    void** ppData)
+{
+    ApiCallTimer timer(API_CALL_MAP_MEMORY);
+    return glad_vkMapMemory(device, memory, offset, size, flags, ppData);
+}
+
+VkResult GLAD_API_PTR countedAllocateMemory(VkDevice device,
+    const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkDeviceMemory* pMemory)
+{
+    ApiCallTimer timer(API_CALL_ALLOCATE_MEMORY);
+    return glad_vkAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+}
+
+VkResult GLAD_API_PTR countedQueueSubmit(VkQueue queue,
+    uint32_t submitCount,
+    const VkSubmitInfo* pSubmits,
+    VkFence fence)
+{
+    ApiCallTimer timer(API_CALL_QUEUE_SUBMIT);
+    return glad_vkQueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+VkResult GLAD_API_PTR countedQueueSubmit2(VkQueue queue,
+    uint32_t submitCount,
+    const VkSubmitInfo2* pSubmits,
+    VkFence fence)
+{
+    ApiCallTimer timer(API_CALL_QUEUE_SUBMIT2);
+    return glad_vkQueueSubmit2(queue, submitCount, pSubmits, fence);
+}
+
+void GLAD_API_PTR countedCmdDraw(VkCommandBuffer commandBuffer,
+    uint32_t vertexCount,
+    uint32_t instanceCount,
+    uint32_t firstVertex,
+    uint32_t firstInstance)
+{
+    ApiCallTimer timer(API_CALL_CMD_DRAW);
+    glad_vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void GLAD_API_PTR countedCmdDrawIndexed(VkCommandBuffer commandBuffer,
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    uint32_t firstInstance)
+{
+    ApiCallTimer timer(API_CALL_CMD_DRAW_INDEXED);
+    glad_vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void GLAD_API_PTR countedCmdDrawIndirect(VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    ApiCallTimer timer(API_CALL_CMD_DRAW_INDIRECT);
+    glad_vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+void GLAD_API_PTR countedCmdDrawIndexedIndirect(VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    uint32_t drawCount,
+    uint32_t stride)
+{
+    ApiCallTimer timer(API_CALL_CMD_DRAW_INDEXED_INDIRECT);
+    glad_vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+void GLAD_API_PTR countedCmdPipelineBarrier(VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask,
+    VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount,
+    const VkMemoryBarrier* pMemoryBarriers,
+    uint32_t bufferMemoryBarrierCount,
+    const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount,
+    const VkImageMemoryBarrier* pImageMemoryBarriers)
+{
+    ApiCallTimer timer(API_CALL_CMD_PIPELINE_BARRIER);
+    glad_vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+        memoryBarrierCount, pMemoryBarriers,
+        bufferMemoryBarrierCount, pBufferMemoryBarriers,
+        imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+void GLAD_API_PTR countedCmdPipelineBarrier2(VkCommandBuffer commandBuffer,
+    const VkDependencyInfo* pDependencyInfo)
+{
+    ApiCallTimer timer(API_CALL_CMD_PIPELINE_BARRIER2);
+    glad_vkCmdPipelineBarrier2(commandBuffer, pDependencyInfo);
+}
+
+// what the debug pointers held before install
+struct SavedDispatch {
+    PFN_vkUpdateDescriptorSets updateDescriptorSets;
+    PFN_vkMapMemory mapMemory;
+    PFN_vkAllocateMemory allocateMemory;
+    PFN_vkQueueSubmit queueSubmit;
+    PFN_vkQueueSubmit2 queueSubmit2;
+    PFN_vkCmdDraw cmdDraw;
+    PFN_vkCmdDrawIndexed cmdDrawIndexed;
+    PFN_vkCmdDrawIndirect cmdDrawIndirect;
+    PFN_vkCmdDrawIndexedIndirect cmdDrawIndexedIndirect;
+    PFN_vkCmdPipelineBarrier cmdPipelineBarrier;
+    PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2;
+} saved;
+
+} // namespace
+
+const char* apiCallName(ApiCall call)
+{
+    return call < API_CALL_COUNT ? API_CALL_NAMES[call] : "unknown";
+}
+
+void installApiCallCounters()
+{
+    if (installed) {
+        return;
+    }
+    saved.updateDescriptorSets = glad_debug_vkUpdateDescriptorSets;
+    saved.mapMemory = glad_debug_vkMapMemory;
+    saved.allocateMemory = glad_debug_vkAllocateMemory;
+    saved.queueSubmit = glad_debug_vkQueueSubmit;
+    saved.queueSubmit2 = glad_debug_vkQueueSubmit2;
+    saved.cmdDraw = glad_debug_vkCmdDraw;
+    saved.cmdDrawIndexed = glad_debug_vkCmdDrawIndexed;
+    saved.cmdDrawIndirect = glad_debug_vkCmdDrawIndirect;
+    saved.cmdDrawIndexedIndirect = glad_debug_vkCmdDrawIndexedIndirect;
+    saved.cmdPipelineBarrier = glad_debug_vkCmdPipelineBarrier;
+    saved.cmdPipelineBarrier2 = glad_debug_vkCmdPipelineBarrier2;
+
+    glad_debug_vkUpdateDescriptorSets = countedUpdateDescriptorSets;
+    glad_debug_vkMapMemory = countedMapMemory;
+    glad_debug_vkAllocateMemory = countedAllocateMemory;
+    glad_debug_vkQueueSubmit = countedQueueSubmit;
+    glad_debug_vkQueueSubmit2 = countedQueueSubmit2;
+    glad_debug_vkCmdDraw = countedCmdDraw;
+    glad_debug_vkCmdDrawIndexed = countedCmdDrawIndexed;
+    glad_debug_vkCmdDrawIndirect = countedCmdDrawIndirect;
+    glad_debug_vkCmdDrawIndexedIndirect = countedCmdDrawIndexedIndirect;
+    glad_debug_vkCmdPipelineBarrier = countedCmdPipelineBarrier;
+    glad_debug_vkCmdPipelineBarrier2 = countedCmdPipelineBarrier2;
+    installed = true;
+}
+
+void uninstallApiCallCounters()
+{
+    if (!installed) {
+        return;
+    }
+    glad_debug_vkUpdateDescriptorSets = saved.updateDescriptorSets;
+    glad_debug_vkMapMemory = saved.mapMemory;
+    glad_debug_vkAllocateMemory = saved.allocateMemory;
+    glad_debug_vkQueueSubmit = saved.queueSubmit;
+    glad_debug_vkQueueSubmit2 = saved.queueSubmit2;
+    glad_debug_vkCmdDraw = saved.cmdDraw;
+    glad_debug_vkCmdDrawIndexed = saved.cmdDrawIndexed;
+    glad_debug_vkCmdDrawIndirect = saved.cmdDrawIndirect;
+    glad_debug_vkCmdDrawIndexedIndirect = saved.cmdDrawIndexedIndirect;
+    glad_debug_vkCmdPipelineBarrier = saved.cmdPipelineBarrier;
+    glad_debug_vkCmdPipelineBarrier2 = saved.cmdPipelineBarrier2;
+    installed = false;
+}
+
+bool apiCallCountersInstalled()
+{
+    return installed;
+}
+
+void endApiCallFrame()
+{
+    for (uint32_t i = 0; i < API_CALL_COUNT; ++i) {
+        lastFrame[i].calls = currentFrame[i].calls.exchange(0, std::memory_order_relaxed);
+        lastFrame[i].nanoseconds = currentFrame[i].nanoseconds.exchange(0, std::memory_order_relaxed);
+        totals[i].calls += lastFrame[i].calls;
+        totals[i].nanoseconds += lastFrame[i].nanoseconds;
+    }
+    frameCount++;
+}
+
+void resetApiCallCounters()
+{
+    for (uint32_t i = 0; i < API_CALL_COUNT; ++i) {
+        currentFrame[i].calls.store(0, std::memory_order_relaxed);
+        currentFrame[i].nanoseconds.store(0, std::memory_order_relaxed);
+        lastFrame[i] = {};
+        totals[i] = {};
+    }
+    frameCount = 0;
+}
+
+const ApiCallStats* lastFrameApiCalls()
+{
+    return lastFrame;
+}
+
+const ApiCallStats* totalApiCalls()
+{
+    return totals;
+}
+
+uint64_t apiCallFrameCount()
+{
+    return frameCount;
+}
+
+std::string apiCallReport()
+{
+    std::string text;
+    char line[192];
+    snprintf(line, sizeof(line), "%-26s %10s %10s %12s %12s\n",
+        "Vulkan calls", "frame", "avg/frame", "frame us", "total ms");
+    text += line;
+    for (uint32_t i = 0; i < API_CALL_COUNT; ++i) {
+        if (totals[i].calls == 0 && lastFrame[i].calls == 0) {
+            continue;
+        }
+        double average = frameCount > 0 ? double(totals[i].calls) / frameCount : 0.0;
+        snprintf(line, sizeof(line), "%-26s %10llu %10.1f %12.2f %12.3f\n",
+            API_CALL_NAMES[i],
+            (unsigned long long)lastFrame[i].calls,
+            average,
+            lastFrame[i].nanoseconds * 1e-3,
+            totals[i].nanoseconds * 1e-6);
+        text += line;
+    }
+    return text;
+}
@@ -0,0 +1,52 @@
+#ifndef HAMON_API_COUNTERS_H__
+#define HAMON_API_COUNTERS_H__
+#include <stdint.h>
+#include <string>
+
+// Counts calls and time spent in selected Vulkan entry points. vulkan.h is
+// generated with glad's debug option, every vkXXX goes through a mutable
+// glad_debug_vkXXX pointer; installing swaps those of the entry points below
+// for counting wrappers that forward to the loaded function. Nothing is paid
+// while not installed.
+
+enum ApiCall {
+    API_CALL_UPDATE_DESCRIPTOR_SETS,
+    API_CALL_MAP_MEMORY,
+    API_CALL_ALLOCATE_MEMORY,
+    API_CALL_QUEUE_SUBMIT,
+    API_CALL_QUEUE_SUBMIT2,
+    API_CALL_CMD_DRAW,
+    API_CALL_CMD_DRAW_INDEXED,
+    API_CALL_CMD_DRAW_INDIRECT,
+    API_CALL_CMD_DRAW_INDEXED_INDIRECT,
+    API_CALL_CMD_PIPELINE_BARRIER,
+    API_CALL_CMD_PIPELINE_BARRIER2,
+    API_CALL_COUNT
+};
+
+struct ApiCallStats {
+    uint64_t calls;
+    uint64_t nanoseconds;
+};
+
+const char* apiCallName(ApiCall call);
+
+// after the last gladLoaderLoadVulkan, which doesn't touch the debug pointers
+void installApiCallCounters();
+void uninstallApiCallCounters();
+bool apiCallCountersInstalled();
+
+// Closes the current frame: its counters become lastFrameApiCalls() and are
+// added to totalApiCalls(). Call once per frame.
+void endApiCallFrame();
+void resetApiCallCounters();
+
+// API_CALL_COUNT entries each
+const ApiCallStats* lastFrameApiCalls();
+const ApiCallStats* totalApiCalls();
+uint64_t apiCallFrameCount();
+
+// last frame and per frame average of the totals, calls with no use skipped
+std::string apiCallReport();
+
+#endif
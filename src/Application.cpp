@@ -9,7 +9,11 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <future>
 #include "Renderer.h"
+#include "Trace.h"
+#include "ApiCounters.h"
+#include "StartupTimeline.h"
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -25,15 +29,22 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 
 void Application::run()
 {
+    // the instance doesn't need the window, only the surface does
+    std::future<void> instanceReady = threadPool_.submit([this] { createInstance(); });
     initWindow();
+    instanceReady.get();
     initVulkan();
     initRenderer();
     mainLoop();
     shutdownVukan();
+#if HAMON_ENABLE_TRACING
+    writeChromeTrace("hamon_trace.json");
+#endif
 }
 
 void Application::initWindow()
 {
+    HAMON_STARTUP_PHASE("create window");
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     const int width = 1280;
@@ -49,11 +60,18 @@ void Application::initRenderer()
     context.format_ = format_;
     context.graphicsQueueFamilyIndex = graphicsQueueFamilyIndex_;
     context.imageViews_ = swapchainImageViews_;
+    context.images_ = swapchainImages_;
     context.swapchain_ = swapchain_;
     context.physicalDevice_ = physicalDevice_;
     context.commandPool_ = createCommandPool(device_, graphicsQueueFamilyIndex_);
     context.descriptorPool_ = createDescriptorPool(device_);
     context.graphicsQueue_ = graphicsQueue_;
+    context.capabilities_ = capabilities_;
+    context.threadPool_ = &threadPool_;
+    context.pipelineKeyFile_ = "../pipelines.txt";
+#ifndef NDEBUG
+    context.gpuReportInterval_ = 600;
+#endif
     
     vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &context.memoryProperties_);
     renderer_ = new Renderer(context);
@@ -70,8 +88,9 @@ void Application::render()
     renderer_->render();
 }
 
-void Application::initVulkan()
+void Application::createInstance()
 {
+    HAMON_STARTUP_PHASE("create instance");
     uint32_t glfwExtensionCount = 0;
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
     std::vector<const char*> rquiredExtensions;
@@ -100,7 +119,8 @@ void Application::initVulkan()
     appInfo.applicationVersion = VK_MAKE_VERSION(0,1,0);
     appInfo.engineVersion = VK_MAKE_VERSION(0,1,0);
     appInfo.pApplicationName = "PBR SandBox";
-    appInfo.apiVersion = VK_API_VERSION_1_1;
+    // 1.3 entry points (vkCmdPipelineBarrier2) are used when the device has them
+    appInfo.apiVersion = VK_API_VERSION_1_3;
 
     VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo ={};
     debugCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -120,26 +140,38 @@ void Application::initVulkan()
     instanceInfo.ppEnabledExtensionNames = rquiredExtensions.data();
     instanceInfo.ppEnabledLayerNames = reuqiredLayers.data();
     instanceInfo.enabledLayerCount = reuqiredLayers.size();
-    VK_CHECK(vkCreateInstance(&instanceInfo, nullptr, &instance_));
+    VK_CHECK(vkCreateInstance(&instanceInfo, hostAllocator(), &instance_));
+
+    physicalDevice_ = getPhysicalDevice(instance_);
+    // instance level entry points (vkGetPhysicalDeviceFeatures2...) are needed
+    // to pick the optional device features
+    gladLoaderLoadVulkan(instance_, physicalDevice_, VK_NULL_HANDLE);
+}
 
+void Application::initVulkan()
+{
+    HAMON_STARTUP_PHASE("init vulkan");
     // create Surface
     VkWin32SurfaceCreateInfoKHR surfaceInfo ={};
     surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
     surfaceInfo.hwnd = glfwGetWin32Window(window);
     surfaceInfo.hinstance = GetModuleHandle(nullptr);
     surfaceInfo.pNext = nullptr;
-    vkCreateWin32SurfaceKHR(instance_, &surfaceInfo, nullptr, &surface_);
-
-    physicalDevice_ = getPhysicalDevice(instance_);
+    vkCreateWin32SurfaceKHR(instance_, &surfaceInfo, hostAllocator(), &surface_);
 
     VkPhysicalDeviceProperties physicalDeviceProperties;
     vkGetPhysicalDeviceProperties(physicalDevice_, &physicalDeviceProperties);
 
-    device_ = createDevice(physicalDevice_, surface_, graphicsQueueFamilyIndex_, presentQueueFamilyIndex_);
+    device_ = createDevice(physicalDevice_, surface_, graphicsQueueFamilyIndex_, presentQueueFamilyIndex_,
+        &capabilities_);
 
     vkGetDeviceQueue(device_, graphicsQueueFamilyIndex_, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, presentQueueFamilyIndex_, 0, &presentQueue_);
     gladLoaderLoadVulkan(instance_, physicalDevice_, device_);
+#ifndef NDEBUG
+    // reported with the GPU profiler results
+    installApiCallCounters();
+#endif
 
     SwapchainSupportDetails details = fetchSwapchainSupportDetails(physicalDevice_, device_, surface_);
     SwapchainSettigs setting = selectOptimalSwapchainSetting(details);
@@ -170,15 +202,15 @@ void Application::shutdownVukan()
 {
     renderer_->shutdown();
     for (auto& imageView: swapchainImageViews_) {
-        vkDestroyImageView(device_, imageView, nullptr);
+        vkDestroyImageView(device_, imageView, hostAllocator());
     }
-    vkDestroySwapchainKHR(device_, swapchain_, nullptr);
+    vkDestroySwapchainKHR(device_, swapchain_, hostAllocator());
     swapchain_ = VK_NULL_HANDLE;
-    vkDestroyDevice(device_, nullptr);
+    vkDestroyDevice(device_, hostAllocator());
     device_ = VK_NULL_HANDLE;
-    vkDestroySurfaceKHR(instance_, surface_, nullptr);
+    vkDestroySurfaceKHR(instance_, surface_, hostAllocator());
     surface_ = NULL;
-    vkDestroyInstance(instance_, nullptr);
+    vkDestroyInstance(instance_, hostAllocator());
 
 }
 
@@ -186,8 +218,18 @@ void Application::mainLoop()
 {
     if (!window)
         return;
+    HAMON_TRACE_THREAD_NAME("main");
+    bool startupReported = false;
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        HAMON_TRACE_SCOPE("frame");
+        {
+            HAMON_TRACE_SCOPE("poll events");
+            glfwPollEvents();
+        }
         render();
+        if (!startupReported) {
+            std::cout << startupReport();
+            startupReported = true;
+        }
     }
 }
\ No newline at end of file
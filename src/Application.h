@@ -3,6 +3,7 @@
 
 #include <GLFW/glfw3.h>
 #include "VulkanUtils.h"
+#include "ThreadPool.h"
 class Application {
 public:
     void run();
@@ -10,6 +11,8 @@ private:
     void initWindow();
     void shutdownWindow();
     void initRenderer();
+    // runs on the thread pool while the window is created
+    void createInstance();
     void initVulkan();
     void shutdownVukan();
 
@@ -19,6 +22,7 @@ private:
 private:
     GLFWwindow* window;
     class Renderer* renderer_;
+    ThreadPool threadPool_;
 
     VkInstance instance_{VK_NULL_HANDLE};
     VkPhysicalDevice physicalDevice_{VK_NULL_HANDLE};
@@ -34,6 +38,7 @@ private:
     std::vector<VkImage> swapchainImages_;
     std::vector<VkImageView> swapchainImageViews_;
     std::vector<VkFramebuffer> swapchainFrameBuffers_;
+    DeviceCapabilities capabilities_;
     bool validationEnable = true;
 };
 
@@ -0,0 +1,195 @@
+#include "GpuProfiler.h"
+#include "VulkanUtils.h"
+#include <stdio.h>
+#include <string.h>
+
+static const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+void GpuProfiler::init(VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    uint32_t queueFamilyIndex,
+    uint32_t frameCount,
+    bool pipelineStatistics)
+{
+    device_ = device;
+
+    VkQueueFamilyProperties familyProperties[16];
+    uint32_t queueFamilyCount = ARRAY_SIZE(familyProperties);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, familyProperties);
+    uint32_t validBits = queueFamilyIndex < queueFamilyCount ?
+        familyProperties[queueFamilyIndex].timestampValidBits : 0;
+    // the queue can't write timestamps, stay disabled
+    if (validBits == 0) {
+        return;
+    }
+    timestampMask_ = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod_ = properties.limits.timestampPeriod;
+    pipelineStatistics_ = pipelineStatistics;
+
+    frames_.resize(frameCount);
+    timestampPools_.resize(frameCount);
+    statisticsPools_.resize(frameCount, VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        timestampPools_[i] = createQueryPool(device_, VK_QUERY_TYPE_TIMESTAMP,
+            GPU_PROFILER_MAX_SCOPES * 2);
+        if (pipelineStatistics_) {
+            statisticsPools_[i] = createQueryPool(device_, VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                GPU_PROFILER_MAX_SCOPES, PIPELINE_STATISTICS);
+        }
+        frames_[i].scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+    }
+    results_.reserve(GPU_PROFILER_MAX_SCOPES);
+}
+
+void GpuProfiler::shutdown()
+{
+    for (VkQueryPool queryPool : timestampPools_) {
+        vkDestroyQueryPool(device_, queryPool, hostAllocator());
+    }
+    for (VkQueryPool queryPool : statisticsPools_) {
+        vkDestroyQueryPool(device_, queryPool, hostAllocator());
+    }
+    timestampPools_.clear();
+    statisticsPools_.clear();
+    frames_.clear();
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frameIndex)
+{
+    if (!enabled()) {
+        return;
+    }
+    readback(frameSlot);
+
+    frameSlot_ = frameSlot;
+    depth_ = 0;
+    statisticsActive_ = false;
+    FrameQueries& frame = frames_[frameSlot];
+    frame.scopes.clear();
+    frame.statisticsCount = 0;
+    frame.frameIndex = frameIndex;
+    vkCmdResetQueryPool(commandBuffer, timestampPools_[frameSlot], 0, GPU_PROFILER_MAX_SCOPES * 2);
+    if (pipelineStatistics_) {
+        vkCmdResetQueryPool(commandBuffer, statisticsPools_[frameSlot], 0, GPU_PROFILER_MAX_SCOPES);
+    }
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name, bool statistics)
+{
+    if (!enabled()) {
+        return GPU_PROFILER_INVALID_SCOPE;
+    }
+    FrameQueries& frame = frames_[frameSlot_];
+    if (frame.scopes.size() >= GPU_PROFILER_MAX_SCOPES) {
+        return GPU_PROFILER_INVALID_SCOPE;
+    }
+    uint32_t scope = static_cast<uint32_t>(frame.scopes.size());
+    Scope entry = {};
+    entry.name = name;
+    entry.depth = depth_++;
+    entry.statisticsQuery = GPU_PROFILER_INVALID_SCOPE;
+    if (statistics && pipelineStatistics_ && !statisticsActive_) {
+        entry.statisticsQuery = frame.statisticsCount++;
+        statisticsActive_ = true;
+        vkCmdBeginQuery(commandBuffer, statisticsPools_[frameSlot_], entry.statisticsQuery, 0);
+    }
+    frame.scopes.push_back(entry);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        timestampPools_[frameSlot_], scope * 2);
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    if (scope == GPU_PROFILER_INVALID_SCOPE) {
+        return;
+    }
+    const Scope& entry = frames_[frameSlot_].scopes[scope];
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        timestampPools_[frameSlot_], scope * 2 + 1);
+    if (entry.statisticsQuery != GPU_PROFILER_INVALID_SCOPE) {
+        vkCmdEndQuery(commandBuffer, statisticsPools_[frameSlot_], entry.statisticsQuery);
+        statisticsActive_ = false;
+    }
+    depth_--;
+}
+
+void GpuProfiler::readback(uint32_t frameSlot)
+{
+    const FrameQueries& frame = frames_[frameSlot];
+    if (frame.scopes.empty()) {
+        return;
+    }
+    uint64_t timestamps[GPU_PROFILER_MAX_SCOPES * 2];
+    uint64_t statistics[GPU_PROFILER_MAX_SCOPES][GPU_STAT_COUNT];
+    uint32_t timestampCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+    // no WAIT bit: the slot's fence already signaled, anything not ready is
+    // dropped instead of stalling the CPU
+    VkResult result = vkGetQueryPoolResults(device_, timestampPools_[frameSlot],
+        0, timestampCount,
+        sizeof(timestamps), timestamps, sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    bool hasStatistics = frame.statisticsCount > 0;
+    if (hasStatistics) {
+        result = vkGetQueryPoolResults(device_, statisticsPools_[frameSlot],
+            0, frame.statisticsCount,
+            sizeof(statistics), statistics, sizeof(statistics[0]),
+            VK_QUERY_RESULT_64_BIT);
+        hasStatistics = result == VK_SUCCESS;
+    }
+
+    results_.clear();
+    for (uint32_t i = 0; i < frame.scopes.size(); ++i) {
+        const Scope& scope = frame.scopes[i];
+        GpuScopeResult scopeResult = {};
+        scopeResult.name = scope.name;
+        scopeResult.depth = scope.depth;
+        uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask_;
+        scopeResult.milliseconds = ticks * timestampPeriod_ * 1e-6;
+        if (hasStatistics && scope.statisticsQuery != GPU_PROFILER_INVALID_SCOPE) {
+            scopeResult.hasStatistics = true;
+            memcpy(scopeResult.statistics, statistics[scope.statisticsQuery], sizeof(scopeResult.statistics));
+        }
+        results_.push_back(scopeResult);
+    }
+    resultFrameIndex_ = frame.frameIndex;
+}
+
+std::string GpuProfiler::report() const
+{
+    std::string text;
+    char line[256];
+    snprintf(line, sizeof(line), "GPU frame %llu\n", (unsigned long long)resultFrameIndex_);
+    text += line;
+    for (const GpuScopeResult& result : results_) {
+        int length = snprintf(line, sizeof(line), "%*s%-*s %8.3f ms",
+            result.depth * 2, "", 24 - result.depth * 2, result.name, result.milliseconds);
+        if (result.hasStatistics && length > 0 && length < (int)sizeof(line)) {
+            snprintf(line + length, sizeof(line) - length,
+                "  verts %llu prims %llu vs %llu clip %llu/%llu fs %llu cs %llu",
+                (unsigned long long)result.statistics[GPU_STAT_INPUT_ASSEMBLY_VERTICES],
+                (unsigned long long)result.statistics[GPU_STAT_INPUT_ASSEMBLY_PRIMITIVES],
+                (unsigned long long)result.statistics[GPU_STAT_VERTEX_SHADER_INVOCATIONS],
+                (unsigned long long)result.statistics[GPU_STAT_CLIPPING_PRIMITIVES],
+                (unsigned long long)result.statistics[GPU_STAT_CLIPPING_INVOCATIONS],
+                (unsigned long long)result.statistics[GPU_STAT_FRAGMENT_SHADER_INVOCATIONS],
+                (unsigned long long)result.statistics[GPU_STAT_COMPUTE_SHADER_INVOCATIONS]);
+        }
+        text += line;
+        text += '\n';
+    }
+    return text;
+}
@@ -0,0 +1,91 @@
+#ifndef HAMON_GPU_PROFILER_H__
+#define HAMON_GPU_PROFILER_H__
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "vulkan.h"
+
+const uint32_t GPU_PROFILER_MAX_SCOPES = 64;
+const uint32_t GPU_PROFILER_INVALID_SCOPE = UINT32_MAX;
+
+// Order matches the result layout of the statistics query (flag bit order)
+enum GpuPipelineStatistic {
+    GPU_STAT_INPUT_ASSEMBLY_VERTICES,
+    GPU_STAT_INPUT_ASSEMBLY_PRIMITIVES,
+    GPU_STAT_VERTEX_SHADER_INVOCATIONS,
+    GPU_STAT_CLIPPING_INVOCATIONS,
+    GPU_STAT_CLIPPING_PRIMITIVES,
+    GPU_STAT_FRAGMENT_SHADER_INVOCATIONS,
+    GPU_STAT_COMPUTE_SHADER_INVOCATIONS,
+    GPU_STAT_COUNT
+};
+
+struct GpuScopeResult {
+    const char* name;
+    uint32_t depth;
+    double milliseconds;
+    bool hasStatistics;
+    uint64_t statistics[GPU_STAT_COUNT];
+};
+
+// Timestamp and pipeline statistics queries around named scopes of the
+// command buffer. There is one query pool pair per frame in flight; results
+// of a frame slot are fetched without waiting when the slot is reused, i.e.
+// after its fence signaled, so they lag frameCount frames behind.
+class GpuProfiler {
+public:
+    void init(VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        uint32_t queueFamilyIndex,
+        uint32_t frameCount,
+        bool pipelineStatistics);
+
+    void shutdown();
+
+    // Fetches the previous results of frameSlot and resets its queries, call
+    // after the slot's fence wait, outside of a render pass.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot, uint64_t frameIndex);
+
+    // name must outlive the results (string literals). Pipeline statistics
+    // can't nest, they are only recorded when no other statistics scope is
+    // open. A scope must begin and end in the same render pass instance.
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, bool statistics = false);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    bool enabled() const { return timestampPools_.size() > 0; }
+
+    // latest completed frame, scopes in the order they began
+    const std::vector<GpuScopeResult>& results() const { return results_; }
+    uint64_t resultFrameIndex() const { return resultFrameIndex_; }
+
+    std::string report() const;
+private:
+    struct Scope {
+        const char* name;
+        uint32_t depth;
+        uint32_t statisticsQuery;
+    };
+
+    struct FrameQueries {
+        std::vector<Scope> scopes;
+        uint32_t statisticsCount = 0;
+        uint64_t frameIndex = 0;
+    };
+
+    void readback(uint32_t frameSlot);
+private:
+    VkDevice device_{VK_NULL_HANDLE};
+    double timestampPeriod_ = 1.0;
+    uint64_t timestampMask_ = ~0ull;
+    bool pipelineStatistics_ = false;
+    std::vector<VkQueryPool> timestampPools_;
+    std::vector<VkQueryPool> statisticsPools_;
+    std::vector<FrameQueries> frames_;
+    uint32_t frameSlot_ = 0;
+    uint32_t depth_ = 0;
+    bool statisticsActive_ = false;
+    std::vector<GpuScopeResult> results_;
+    uint64_t resultFrameIndex_ = 0;
+};
+
+#endif
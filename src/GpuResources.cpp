@@ -0,0 +1,180 @@
+#include "GpuResources.h"
+#include "VulkanUtils.h"
+#include <assert.h>
+
+void GpuResources::init(VkDevice device,
+    VkPhysicalDevice physicalDevice,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    bool memoryBudget)
+{
+    device_ = device;
+    memoryProperties_ = memoryProperties;
+    memoryStats_.init(physicalDevice, memoryProperties, memoryBudget);
+}
+
+BufferHandle GpuResources::createBuffer(MemoryCategory category,
+    VkBufferUsageFlags usage,
+    VkDeviceSize size,
+    VkMemoryPropertyFlags memoryPropertyFlags)
+{
+    GpuBuffer buffer = {};
+    buffer.size = size;
+    buffer.category = category;
+    buffer.buffer = ::createBuffer(device_, usage, size);
+    MemoryAllocation allocation = {};
+    buffer.memory = createBufferMemory(device_, buffer.buffer, memoryProperties_, memoryPropertyFlags,
+        &allocation);
+    buffer.memoryTypeIndex = allocation.memoryTypeIndex;
+    buffer.allocationSize = allocation.size;
+    memoryStats_.recordAllocation(category, allocation.memoryTypeIndex, allocation.size);
+    VK_CHECK(vkBindBufferMemory(device_, buffer.buffer, buffer.memory, 0));
+    if (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK(vkMapMemory(device_, buffer.memory, 0, size, 0, &buffer.mapped));
+    }
+    return buffers_.insert(buffer);
+}
+
+ImageHandle GpuResources::createImage2D(MemoryCategory category,
+    VkFormat format,
+    VkImageUsageFlags usage,
+    VkImageAspectFlags aspect,
+    uint32_t width,
+    uint32_t height,
+    uint32_t mipLevels)
+{
+    GpuImage image = {};
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.mipLevels = mipLevels;
+    image.category = category;
+    image.image = ::createImage2D(device_, format, usage, width, height, mipLevels, 1);
+    MemoryAllocation allocation = {};
+    image.memory = createImageMemory(device_, image.image, memoryProperties_,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation);
+    image.memoryTypeIndex = allocation.memoryTypeIndex;
+    image.allocationSize = allocation.size;
+    memoryStats_.recordAllocation(category, allocation.memoryTypeIndex, allocation.size);
+    VK_CHECK(vkBindImageMemory(device_, image.image, image.memory, 0));
+    image.view = createImageView2D(device_, image.image, aspect, format, mipLevels);
+    return images_.insert(image);
+}
+
+PipelineHandle GpuResources::addPipeline(VkPipeline pipeline)
+{
+    return pipelines_.insert(pipeline);
+}
+
+void GpuResources::destroy(BufferHandle handle)
+{
+    const GpuBuffer* buffer = buffers_.find(handle);
+    if (buffer == nullptr) {
+        return;
+    }
+    destroyBuffer(*buffer);
+    buffers_.erase(handle);
+}
+
+void GpuResources::destroy(ImageHandle handle)
+{
+    const GpuImage* image = images_.find(handle);
+    if (image == nullptr) {
+        return;
+    }
+    destroyImage(*image);
+    images_.erase(handle);
+}
+
+void GpuResources::destroy(PipelineHandle handle)
+{
+    const VkPipeline* pipeline = pipelines_.find(handle);
+    if (pipeline == nullptr) {
+        return;
+    }
+    vkDestroyPipeline(device_, *pipeline, hostAllocator());
+    pipelines_.erase(handle);
+}
+
+void GpuResources::release(BufferHandle handle, uint64_t frame)
+{
+    if (buffers_.contains(handle)) {
+        pushRelease(ResourceKind::Buffer, handle.value(), frame);
+    }
+}
+
+void GpuResources::release(ImageHandle handle, uint64_t frame)
+{
+    if (images_.contains(handle)) {
+        pushRelease(ResourceKind::Image, handle.value(), frame);
+    }
+}
+
+void GpuResources::release(PipelineHandle handle, uint64_t frame)
+{
+    if (pipelines_.contains(handle)) {
+        pushRelease(ResourceKind::Pipeline, handle.value(), frame);
+    }
+}
+
+void GpuResources::pushRelease(ResourceKind kind, uint64_t handle, uint64_t frame)
+{
+    assert(pendingReleases_.empty() || pendingReleases_.back().frame <= frame);
+    PendingRelease pending = {};
+    pending.frame = frame;
+    pending.kind = kind;
+    pending.handle = handle;
+    pendingReleases_.push_back(pending);
+}
+
+void GpuResources::collect(uint64_t completedFrame)
+{
+    while (!pendingReleases_.empty() && pendingReleases_.front().frame <= completedFrame) {
+        const PendingRelease& pending = pendingReleases_.front();
+        switch (pending.kind) {
+        case ResourceKind::Buffer:
+            destroy(BufferHandle(pending.handle));
+            break;
+        case ResourceKind::Image:
+            destroy(ImageHandle(pending.handle));
+            break;
+        case ResourceKind::Pipeline:
+            destroy(PipelineHandle(pending.handle));
+            break;
+        }
+        pendingReleases_.pop_front();
+    }
+}
+
+void GpuResources::destroyAll()
+{
+    // pending releases are still in the maps, destroyed below
+    pendingReleases_.clear();
+    for (const GpuBuffer& buffer : buffers_) {
+        destroyBuffer(buffer);
+    }
+    for (const GpuImage& image : images_) {
+        destroyImage(image);
+    }
+    for (VkPipeline pipeline : pipelines_) {
+        vkDestroyPipeline(device_, pipeline, hostAllocator());
+    }
+    buffers_.clear();
+    images_.clear();
+    pipelines_.clear();
+}
+
+void GpuResources::destroyBuffer(const GpuBuffer& buffer)
+{
+    // freeing the memory implicitly unmaps it
+    vkDestroyBuffer(device_, buffer.buffer, hostAllocator());
+    vkFreeMemory(device_, buffer.memory, hostAllocator());
+    memoryStats_.recordFree(buffer.category, buffer.memoryTypeIndex, buffer.allocationSize);
+}
+
+void GpuResources::destroyImage(const GpuImage& image)
+{
+    vkDestroyImageView(device_, image.view, hostAllocator());
+    vkDestroyImage(device_, image.image, hostAllocator());
+    vkFreeMemory(device_, image.memory, hostAllocator());
+    memoryStats_.recordFree(image.category, image.memoryTypeIndex, image.allocationSize);
+}
@@ -0,0 +1,130 @@
+#ifndef HAMON_GPU_RESOURCES_H__
+#define HAMON_GPU_RESOURCES_H__
+#include "vulkan.h"
+#include "SlotMap.h"
+#include "MemoryStats.h"
+#include <deque>
+
+struct BufferTag {};
+struct ImageTag {};
+struct PipelineTag {};
+
+typedef SlotHandle<BufferTag> BufferHandle;
+typedef SlotHandle<ImageTag> ImageHandle;
+typedef SlotHandle<PipelineTag> PipelineHandle;
+
+struct GpuBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    // host visible buffers stay mapped for their whole lifetime
+    void* mapped;
+    MemoryCategory category;
+    uint32_t memoryTypeIndex;
+    VkDeviceSize allocationSize;
+};
+
+struct GpuImage {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    MemoryCategory category;
+    uint32_t memoryTypeIndex;
+    VkDeviceSize allocationSize;
+};
+
+// Owns the renderer's buffers, images and pipelines. Everything outside only
+// keeps handles, so a handle used after its resource was destroyed is caught
+// (asserts) instead of silently reaching a dead or recycled Vulkan object.
+class GpuResources {
+public:
+    // memoryBudget: the device has VK_EXT_memory_budget enabled
+    void init(VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        bool memoryBudget);
+
+    BufferHandle createBuffer(MemoryCategory category,
+        VkBufferUsageFlags usage,
+        VkDeviceSize size,
+        VkMemoryPropertyFlags memoryPropertyFlags);
+
+    // image, bound memory and a default 2D view
+    ImageHandle createImage2D(MemoryCategory category,
+        VkFormat format,
+        VkImageUsageFlags usage,
+        VkImageAspectFlags aspect,
+        uint32_t width,
+        uint32_t height,
+        uint32_t mipLevels = 1);
+
+    // takes ownership of a pipeline created by the createXXXPipeline helpers
+    PipelineHandle addPipeline(VkPipeline pipeline);
+
+    const GpuBuffer& buffer(BufferHandle handle) const { return buffers_[handle]; }
+    const GpuImage& image(ImageHandle handle) const { return images_[handle]; }
+    VkPipeline pipeline(PipelineHandle handle) const { return pipelines_[handle]; }
+
+    bool isValid(BufferHandle handle) const { return buffers_.contains(handle); }
+    bool isValid(ImageHandle handle) const { return images_.contains(handle); }
+    bool isValid(PipelineHandle handle) const { return pipelines_.contains(handle); }
+
+    // Immediate destruction, only safe once the GPU no longer uses the
+    // resource (e.g. after vkDeviceWaitIdle). Stale or null handles are ignored.
+    void destroy(BufferHandle handle);
+    void destroy(ImageHandle handle);
+    void destroy(PipelineHandle handle);
+
+    // Deferred destruction: frame is the index of the frame being recorded,
+    // the resource is destroyed by collect() once that frame has completed on
+    // the GPU. The handle must not be used after release.
+    void release(BufferHandle handle, uint64_t frame);
+    void release(ImageHandle handle, uint64_t frame);
+    void release(PipelineHandle handle, uint64_t frame);
+
+    // destroys everything released in frames <= completedFrame
+    void collect(uint64_t completedFrame);
+
+    // also destroys pending releases, the device must be idle
+    void destroyAll();
+
+    uint32_t bufferCount() const { return static_cast<uint32_t>(buffers_.size()); }
+    uint32_t imageCount() const { return static_cast<uint32_t>(images_.size()); }
+    uint32_t pipelineCount() const { return static_cast<uint32_t>(pipelines_.size()); }
+    uint32_t pendingReleaseCount() const { return static_cast<uint32_t>(pendingReleases_.size()); }
+
+    MemoryStats& memoryStats() { return memoryStats_; }
+    const MemoryStats& memoryStats() const { return memoryStats_; }
+private:
+    enum class ResourceKind {
+        Buffer,
+        Image,
+        Pipeline,
+    };
+
+    struct PendingRelease {
+        uint64_t frame;
+        ResourceKind kind;
+        uint64_t handle;
+    };
+
+    void pushRelease(ResourceKind kind, uint64_t handle, uint64_t frame);
+
+    void destroyBuffer(const GpuBuffer& buffer);
+    void destroyImage(const GpuImage& image);
+private:
+    VkDevice device_{VK_NULL_HANDLE};
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+    SlotMap<BufferTag, GpuBuffer> buffers_;
+    SlotMap<ImageTag, GpuImage> images_;
+    SlotMap<PipelineTag, VkPipeline> pipelines_;
+    // ordered by frame, frames are released in increasing order
+    std::deque<PendingRelease> pendingReleases_;
+    MemoryStats memoryStats_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "GpuTimeline.h"
+#include "VulkanUtils.h"
+#include <assert.h>
+
+// the binary semaphores of a submit plus the timeline one
+static const uint32_t MAX_SIGNAL_SEMAPHORES = 8;
+
+void GpuTimeline::init(VkDevice device, bool timelineSemaphore)
+{
+    device_ = device;
+    if (timelineSemaphore) {
+        semaphore_ = createTimelineSemaphore(device, 0);
+    }
+}
+
+void GpuTimeline::shutdown()
+{
+    if (semaphore_ != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device_, semaphore_, hostAllocator());
+        semaphore_ = VK_NULL_HANDLE;
+    }
+    for (const PendingFence& pending : pending_) {
+        vkDestroyFence(device_, pending.fence, hostAllocator());
+    }
+    for (VkFence fence : freeFences_) {
+        vkDestroyFence(device_, fence, hostAllocator());
+    }
+    pending_.clear();
+    freeFences_.clear();
+}
+
+void GpuTimeline::submit(VkQueue queue, const VkSubmitInfo& info, uint64_t value)
+{
+    assert(value > submittedValue_);
+    submittedValue_ = value;
+    if (semaphore_ == VK_NULL_HANDLE) {
+        VkFence fence = VK_NULL_HANDLE;
+        if (freeFences_.empty()) {
+            fence = createFence(device_);
+        }
+        else {
+            fence = freeFences_.back();
+            freeFences_.pop_back();
+        }
+        vkResetFences(device_, 1, &fence);
+        vkQueueSubmit(queue, 1, &info, fence);
+        pending_.push_back({value, fence});
+        return;
+    }
+
+    assert(info.signalSemaphoreCount < MAX_SIGNAL_SEMAPHORES);
+    VkSemaphore signalSemaphores[MAX_SIGNAL_SEMAPHORES];
+    // binary semaphores ignore their value
+    uint64_t signalValues[MAX_SIGNAL_SEMAPHORES] = {};
+    for (uint32_t i = 0; i < info.signalSemaphoreCount; ++i) {
+        signalSemaphores[i] = info.pSignalSemaphores[i];
+    }
+    signalSemaphores[info.signalSemaphoreCount] = semaphore_;
+    signalValues[info.signalSemaphoreCount] = value;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.pNext = info.pNext;
+    timelineInfo.waitSemaphoreValueCount = 0;
+    timelineInfo.pWaitSemaphoreValues = nullptr;
+    timelineInfo.signalSemaphoreValueCount = info.signalSemaphoreCount + 1;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+
+    VkSubmitInfo timelineSubmit = info;
+    timelineSubmit.pNext = &timelineInfo;
+    timelineSubmit.signalSemaphoreCount = info.signalSemaphoreCount + 1;
+    timelineSubmit.pSignalSemaphores = signalSemaphores;
+    vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE);
+}
+
+uint64_t GpuTimeline::completedValue()
+{
+    if (semaphore_ != VK_NULL_HANDLE) {
+        vkGetSemaphoreCounterValue(device_, semaphore_, &completedValue_);
+    }
+    else {
+        retireFences();
+    }
+    return completedValue_;
+}
+
+void GpuTimeline::wait(uint64_t value)
+{
+    if (value <= completedValue_) {
+        return;
+    }
+    if (semaphore_ != VK_NULL_HANDLE) {
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.pNext = nullptr;
+        waitInfo.flags = 0;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore_;
+        waitInfo.pValues = &value;
+        vkWaitSemaphores(device_, &waitInfo, UINT64_MAX);
+        completedValue_ = value;
+        return;
+    }
+    // the queue completes in submission order, the first fence at or past
+    // value covers everything before it
+    for (const PendingFence& pending : pending_) {
+        if (pending.value >= value) {
+            vkWaitForFences(device_, 1, &pending.fence, VK_TRUE, UINT64_MAX);
+            break;
+        }
+    }
+    retireFences();
+}
+
+void GpuTimeline::retireFences()
+{
+    size_t retired = 0;
+    while (retired < pending_.size() &&
+        vkGetFenceStatus(device_, pending_[retired].fence) == VK_SUCCESS) {
+        completedValue_ = pending_[retired].value;
+        freeFences_.push_back(pending_[retired].fence);
+        ++retired;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + retired);
+}
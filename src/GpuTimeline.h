@@ -0,0 +1,46 @@
+#ifndef HAMON_GPU_TIMELINE_H__
+#define HAMON_GPU_TIMELINE_H__
+#include <stdint.h>
+#include <vector>
+#include "vulkan.h"
+
+// Completion counter of one queue. Every submit() signals a larger value,
+// so "has the GPU finished X" for frames, deferred deletion or uploads is a
+// single compare against completedValue(). Backed by a timeline semaphore,
+// or by one fence per pending submit on devices without them.
+class GpuTimeline {
+public:
+    void init(VkDevice device, bool timelineSemaphore);
+    // the device must be idle
+    void shutdown();
+
+    // Submits info signalling value (> every value before) on top of its own
+    // signal semaphores. info.pNext must not already hold a
+    // VkTimelineSemaphoreSubmitInfo.
+    void submit(VkQueue queue, const VkSubmitInfo& info, uint64_t value);
+
+    // one counter read, fence status polling in the fallback
+    uint64_t completedValue();
+    void wait(uint64_t value);
+
+    uint64_t submittedValue() const { return submittedValue_; }
+    bool timelineSemaphore() const { return semaphore_ != VK_NULL_HANDLE; }
+private:
+    struct PendingFence {
+        uint64_t value;
+        VkFence fence;
+    };
+
+    // retires every signalled fence at the front of pending_
+    void retireFences();
+private:
+    VkDevice device_{VK_NULL_HANDLE};
+    VkSemaphore semaphore_{VK_NULL_HANDLE};
+    uint64_t submittedValue_ = 0;
+    uint64_t completedValue_ = 0;
+    // fallback only, in submission order
+    std::vector<PendingFence> pending_;
+    std::vector<VkFence> freeFences_;
+};
+
+#endif
@@ -0,0 +1,317 @@
+#include "HostAllocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+
+namespace {
+
+// 16 .. 4096 bytes, header included
+const uint32_t SIZE_CLASS_COUNT = 9;
+const uint32_t MIN_CLASS_SHIFT = 4;
+const size_t MAX_POOL_ALIGNMENT = 64;
+const size_t CHUNK_SIZE = 64 * 1024;
+const uint16_t LARGE_ALLOCATION = 0xffff;
+
+// sits right before the pointer handed to the driver
+struct AllocationHeader {
+    uint64_t size;
+    uint16_t sizeClass;
+    uint8_t scope;
+    uint8_t unused;
+    // from the start of the slot / malloc block
+    uint32_t offset;
+};
+static_assert(sizeof(AllocationHeader) == 16, "header must keep 16 byte alignment");
+
+struct FreeSlot {
+    FreeSlot* next;
+};
+
+struct SizeClassPool {
+    std::mutex mutex;
+    FreeSlot* freeList = nullptr;
+};
+
+SizeClassPool pools[SIZE_CLASS_COUNT];
+
+struct ScopeCounters {
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> peakBytes;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> internalBytes;
+};
+
+ScopeCounters scopes[HOST_ALLOCATION_SCOPE_COUNT];
+std::atomic<uint64_t> allocationCalls(0);
+std::atomic<uint64_t> reallocationCalls(0);
+std::atomic<uint64_t> freeCalls(0);
+std::atomic<uint64_t> poolBytes(0);
+std::atomic<uint64_t> largeBytes(0);
+
+const char* const SCOPE_NAMES[HOST_ALLOCATION_SCOPE_COUNT] = {
+    "command",
+    "object",
+    "cache",
+    "device",
+    "instance",
+};
+
+size_t classSize(uint32_t sizeClass)
+{
+    return size_t(1) << (sizeClass + MIN_CLASS_SHIFT);
+}
+
+uint32_t scopeIndex(VkSystemAllocationScope scope)
+{
+    uint32_t index = static_cast<uint32_t>(scope);
+    return index < HOST_ALLOCATION_SCOPE_COUNT ? index : VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+}
+
+void countAllocation(uint32_t scope, uint64_t size)
+{
+    ScopeCounters& counters = scopes[scope];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    uint64_t bytes = counters.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !counters.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+void countFree(uint32_t scope, uint64_t size)
+{
+    scopes[scope].allocations.fetch_sub(1, std::memory_order_relaxed);
+    scopes[scope].bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* popSlot(uint32_t sizeClass)
+{
+    SizeClassPool& pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (pool.freeList == nullptr) {
+        // chunks are carved into slots once and never given back
+        const size_t slotSize = classSize(sizeClass);
+        uint8_t* memory = static_cast<uint8_t*>(malloc(CHUNK_SIZE + MAX_POOL_ALIGNMENT));
+        if (memory == nullptr) {
+            return nullptr;
+        }
+        uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+        uint8_t* chunk = memory + ((MAX_POOL_ALIGNMENT - address % MAX_POOL_ALIGNMENT) % MAX_POOL_ALIGNMENT);
+        poolBytes.fetch_add(CHUNK_SIZE + MAX_POOL_ALIGNMENT, std::memory_order_relaxed);
+        for (size_t offset = CHUNK_SIZE; offset >= slotSize; offset -= slotSize) {
+            FreeSlot* slot = reinterpret_cast<FreeSlot*>(chunk + offset - slotSize);
+            slot->next = pool.freeList;
+            pool.freeList = slot;
+        }
+    }
+    FreeSlot* slot = pool.freeList;
+    pool.freeList = slot->next;
+    return slot;
+}
+
+void pushSlot(uint32_t sizeClass, void* memory)
+{
+    SizeClassPool& pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    FreeSlot* slot = static_cast<FreeSlot*>(memory);
+    slot->next = pool.freeList;
+    pool.freeList = slot;
+}
+
+AllocationHeader* headerOf(void* memory)
+{
+    return reinterpret_cast<AllocationHeader*>(static_cast<uint8_t*>(memory) - sizeof(AllocationHeader));
+}
+
+void* allocate(size_t size, size_t alignment, uint32_t scope)
+{
+    alignment = alignment < sizeof(AllocationHeader) ? sizeof(AllocationHeader) : alignment;
+    // the payload starts one alignment step in, the header fills the gap
+    const size_t required = size + alignment;
+    uint8_t* block = nullptr;
+    uint16_t sizeClass = LARGE_ALLOCATION;
+    if (alignment <= MAX_POOL_ALIGNMENT && required <= classSize(SIZE_CLASS_COUNT - 1)) {
+        sizeClass = 0;
+        while (classSize(sizeClass) < required) {
+            sizeClass++;
+        }
+        // slots of at least 64 bytes are 64 byte aligned, smaller ones to
+        // their size, which covers the alignment since required > alignment
+        block = static_cast<uint8_t*>(popSlot(sizeClass));
+    }
+    else {
+        block = static_cast<uint8_t*>(malloc(required + alignment));
+        if (block != nullptr) {
+            largeBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+    if (block == nullptr) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+    uint8_t* memory = reinterpret_cast<uint8_t*>((start + alignment - 1) & ~uintptr_t(alignment - 1));
+    AllocationHeader* header = headerOf(memory);
+    header->size = size;
+    header->sizeClass = sizeClass;
+    header->scope = static_cast<uint8_t>(scope);
+    header->unused = 0;
+    header->offset = static_cast<uint32_t>(memory - block);
+    countAllocation(scope, size);
+    return memory;
+}
+
+void release(void* memory)
+{
+    AllocationHeader* header = headerOf(memory);
+    countFree(header->scope, header->size);
+    uint8_t* block = static_cast<uint8_t*>(memory) - header->offset;
+    if (header->sizeClass == LARGE_ALLOCATION) {
+        largeBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        free(block);
+        return;
+    }
+    pushSlot(header->sizeClass, block);
+}
+
+void* VKAPI_PTR hostAllocation(void* pUserData,
+    size_t size,
+    size_t alignment,
+    VkSystemAllocationScope allocationScope)
+{
+    allocationCalls.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) {
+        return nullptr;
+    }
+    return allocate(size, alignment, scopeIndex(allocationScope));
+}
+
+void* VKAPI_PTR hostReallocation(void* pUserData,
+    void* pOriginal,
+    size_t size,
+    size_t alignment,
+    VkSystemAllocationScope allocationScope)
+{
+    reallocationCalls.fetch_add(1, std::memory_order_relaxed);
+    if (pOriginal == nullptr) {
+        return size != 0 ? allocate(size, alignment, scopeIndex(allocationScope)) : nullptr;
+    }
+    if (size == 0) {
+        release(pOriginal);
+        return nullptr;
+    }
+    AllocationHeader* header = headerOf(pOriginal);
+    // grow or shrink in place while the slot still holds it
+    uintptr_t address = reinterpret_cast<uintptr_t>(pOriginal);
+    if (header->sizeClass != LARGE_ALLOCATION &&
+        (address & (alignment - 1)) == 0 &&
+        header->offset + size <= classSize(header->sizeClass)) {
+        countFree(header->scope, header->size);
+        header->size = size;
+        countAllocation(header->scope, size);
+        return pOriginal;
+    }
+    // the spec keeps the original scope for reallocations
+    void* memory = allocate(size, alignment, header->scope);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    memcpy(memory, pOriginal, header->size < size ? header->size : size);
+    release(pOriginal);
+    return memory;
+}
+
+void VKAPI_PTR hostFree(void* pUserData, void* pMemory)
+{
+    if (pMemory == nullptr) {
+        return;
+    }
+    freeCalls.fetch_add(1, std::memory_order_relaxed);
+    release(pMemory);
+}
+
+void VKAPI_PTR hostInternalAllocation(void* pUserData,
+    size_t size,
+    VkInternalAllocationType allocationType,
+    VkSystemAllocationScope allocationScope)
+{
+    scopes[scopeIndex(allocationScope)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_PTR hostInternalFree(void* pUserData,
+    size_t size,
+    VkInternalAllocationType allocationType,
+    VkSystemAllocationScope allocationScope)
+{
+    scopes[scopeIndex(allocationScope)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+const VkAllocationCallbacks HOST_ALLOCATION_CALLBACKS = {
+    nullptr,
+    hostAllocation,
+    hostReallocation,
+    hostFree,
+    hostInternalAllocation,
+    hostInternalFree,
+};
+
+} // namespace
+
+const VkAllocationCallbacks* hostAllocator()
+{
+#if HAMON_HOST_ALLOCATOR
+    return &HOST_ALLOCATION_CALLBACKS;
+#else
+    return nullptr;
+#endif
+}
+
+const char* hostAllocationScopeName(uint32_t scope)
+{
+    return scope < HOST_ALLOCATION_SCOPE_COUNT ? SCOPE_NAMES[scope] : "unknown";
+}
+
+HostAllocationStats hostAllocationStats()
+{
+    HostAllocationStats stats = {};
+    for (uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; ++i) {
+        stats.bytes[i] = scopes[i].bytes.load(std::memory_order_relaxed);
+        stats.peakBytes[i] = scopes[i].peakBytes.load(std::memory_order_relaxed);
+        stats.allocations[i] = scopes[i].allocations.load(std::memory_order_relaxed);
+        stats.internalBytes[i] = scopes[i].internalBytes.load(std::memory_order_relaxed);
+    }
+    stats.allocationCalls = allocationCalls.load(std::memory_order_relaxed);
+    stats.reallocationCalls = reallocationCalls.load(std::memory_order_relaxed);
+    stats.freeCalls = freeCalls.load(std::memory_order_relaxed);
+    stats.poolBytes = poolBytes.load(std::memory_order_relaxed);
+    stats.largeBytes = largeBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string hostAllocationReport()
+{
+    HostAllocationStats stats = hostAllocationStats();
+    std::string text;
+    char line[160];
+    snprintf(line, sizeof(line), "%-12s %10s %12s %12s %12s\n",
+        "host scope", "live", "KB", "peak KB", "internal KB");
+    text += line;
+    for (uint32_t i = 0; i < HOST_ALLOCATION_SCOPE_COUNT; ++i) {
+        snprintf(line, sizeof(line), "%-12s %10llu %12.1f %12.1f %12.1f\n",
+            SCOPE_NAMES[i],
+            (unsigned long long)stats.allocations[i],
+            stats.bytes[i] / 1024.0,
+            stats.peakBytes[i] / 1024.0,
+            stats.internalBytes[i] / 1024.0);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "pools %.1f KB, large %.1f KB, calls alloc %llu realloc %llu free %llu\n",
+        stats.poolBytes / 1024.0,
+        stats.largeBytes / 1024.0,
+        (unsigned long long)stats.allocationCalls,
+        (unsigned long long)stats.reallocationCalls,
+        (unsigned long long)stats.freeCalls);
+    text += line;
+    return text;
+}
@@ -0,0 +1,44 @@
+#ifndef HAMON_HOST_ALLOCATOR_H__
+#define HAMON_HOST_ALLOCATOR_H__
+#include <stdint.h>
+#include <string>
+#include "vulkan.h"
+
+// VkAllocationCallbacks for every vkCreate* / vkAllocateMemory and the
+// matching destroy / free. Small allocations come from size-class pools,
+// whose chunks are kept for the life of the process; anything larger than
+// the biggest class or aligned beyond 64 bytes goes to malloc. Build with
+// HAMON_HOST_ALLOCATOR=0 to hand the driver nullptr callbacks instead.
+
+#ifndef HAMON_HOST_ALLOCATOR
+#define HAMON_HOST_ALLOCATOR 1
+#endif
+
+// VK_SYSTEM_ALLOCATION_SCOPE_COMMAND .. INSTANCE
+const uint32_t HOST_ALLOCATION_SCOPE_COUNT = 5;
+
+struct HostAllocationStats {
+    // live allocations through the callbacks, per VkSystemAllocationScope
+    uint64_t bytes[HOST_ALLOCATION_SCOPE_COUNT];
+    uint64_t peakBytes[HOST_ALLOCATION_SCOPE_COUNT];
+    uint64_t allocations[HOST_ALLOCATION_SCOPE_COUNT];
+    // executable memory the driver allocated itself and reported
+    uint64_t internalBytes[HOST_ALLOCATION_SCOPE_COUNT];
+    // calls since start
+    uint64_t allocationCalls;
+    uint64_t reallocationCalls;
+    uint64_t freeCalls;
+    // chunk memory owned by the pools, used or not
+    uint64_t poolBytes;
+    // live allocations that bypassed the pools
+    uint64_t largeBytes;
+};
+
+// the same pointer for every call, nullptr with HAMON_HOST_ALLOCATOR=0
+const VkAllocationCallbacks* hostAllocator();
+
+const char* hostAllocationScopeName(uint32_t scope);
+HostAllocationStats hostAllocationStats();
+std::string hostAllocationReport();
+
+#endif
@@ -0,0 +1,265 @@
+#include "ImageStateTracker.h"
+#include <assert.h>
+#include <stdio.h>
+
+struct AccessInfo {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    bool write;
+};
+
+// indexed by ImageAccess
+static const AccessInfo ACCESS_INFOS[IMAGE_ACCESS_COUNT] = {
+    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT, false},
+    {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT, true},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT, false},
+    {VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT, false},
+    {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true},
+    {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        true},
+    // presentation waits on a semaphore, the barrier only has to order the
+    // layout change after the last use
+    {VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, false},
+};
+
+bool ImageStateTracker::sameState(const SubresourceState& a, const SubresourceState& b)
+{
+    return a.layout == b.layout &&
+        a.writeStages == b.writeStages &&
+        a.writeAccess == b.writeAccess &&
+        a.readStages == b.readStages &&
+        a.visibleStages == b.visibleStages &&
+        a.pending == b.pending;
+}
+
+void ImageStateTracker::registerImage(VkImage image,
+    VkImageAspectFlags aspect,
+    uint32_t mipLevels,
+    uint32_t arrayLayers,
+    VkImageLayout initialLayout)
+{
+    TrackedImage& tracked = images_[image];
+    tracked.aspect = aspect;
+    tracked.mipLevels = mipLevels;
+    tracked.arrayLayers = arrayLayers;
+    SubresourceState state = {};
+    state.layout = initialLayout;
+    tracked.states.assign(size_t(mipLevels) * arrayLayers, state);
+}
+
+void ImageStateTracker::forgetImage(VkImage image)
+{
+    images_.erase(image);
+    for (size_t i = 0; i < barriers_.size(); ) {
+        if (barriers_[i].image == image) {
+            barriers_.erase(barriers_.begin() + i);
+            continue;
+        }
+        ++i;
+    }
+}
+
+void ImageStateTracker::transition(VkCommandBuffer commandBuffer,
+    VkImage image,
+    ImageAccess access,
+    bool discard)
+{
+    auto it = images_.find(image);
+    assert(it != images_.end());
+    transition(commandBuffer, image, 0, it->second.mipLevels, 0, it->second.arrayLayers, access, discard);
+}
+
+void ImageStateTracker::transition(VkCommandBuffer commandBuffer,
+    VkImage image,
+    uint32_t baseMipLevel,
+    uint32_t levelCount,
+    uint32_t baseArrayLayer,
+    uint32_t layerCount,
+    ImageAccess access,
+    bool discard)
+{
+    auto it = images_.find(image);
+    assert(it != images_.end());
+    TrackedImage& tracked = it->second;
+    assert(baseMipLevel + levelCount <= tracked.mipLevels);
+    assert(baseArrayLayer + layerCount <= tracked.arrayLayers);
+    const AccessInfo& info = ACCESS_INFOS[access];
+    ++requested_;
+
+    bool pending = false;
+    for (uint32_t layer = baseArrayLayer; layer < baseArrayLayer + layerCount && !pending; ++layer) {
+        for (uint32_t mip = baseMipLevel; mip < baseMipLevel + levelCount; ++mip) {
+            if (tracked.states[layer * tracked.mipLevels + mip].pending) {
+                pending = true;
+                break;
+            }
+        }
+    }
+    if (pending) {
+        flush(commandBuffer);
+    }
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = tracked.aspect;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.newLayout = info.layout;
+    barrier.dstAccessMask = info.access;
+
+    uint32_t queued = 0;
+    for (uint32_t layer = baseArrayLayer; layer < baseArrayLayer + layerCount; ++layer) {
+        uint32_t end = baseMipLevel + levelCount;
+        for (uint32_t mip = baseMipLevel; mip < end; ) {
+            SubresourceState* states = &tracked.states[layer * tracked.mipLevels];
+            const SubresourceState state = states[mip];
+            // neighbouring mips in the same state share a barrier
+            uint32_t run = 1;
+            while (mip + run < end && sameState(states[mip + run], state)) {
+                ++run;
+            }
+
+            SubresourceState next = state;
+            VkPipelineStageFlags srcStages = 0;
+            bool needed = false;
+            if (state.layout != info.layout || info.write) {
+                // the layout change or the write must wait for every access
+                // before it, reads only need ordering, writes availability
+                needed = state.layout != info.layout ||
+                    state.writeStages != 0 || state.readStages != 0;
+                srcStages = state.writeStages | state.readStages;
+                barrier.srcAccessMask = discard ? 0 : state.writeAccess;
+                barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                next.layout = info.layout;
+                if (info.write) {
+                    next.writeStages = info.stages;
+                    next.writeAccess = info.access;
+                    next.readStages = 0;
+                    next.visibleStages = 0;
+                }
+                else {
+                    // the transition is the last write, visible to these
+                    // stages, later readers chain off them
+                    next.writeStages = info.stages;
+                    next.writeAccess = 0;
+                    next.readStages = info.stages;
+                    next.visibleStages = info.stages;
+                }
+            }
+            else {
+                // read in the current layout, only a write not yet made
+                // visible to these stages needs a barrier
+                needed = state.writeStages != 0 && (info.stages & ~state.visibleStages) != 0;
+                srcStages = state.writeStages;
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.oldLayout = state.layout;
+                next.readStages |= info.stages;
+                if (needed) {
+                    next.visibleStages |= info.stages;
+                }
+            }
+
+            if (needed) {
+                next.pending = true;
+                barrier.subresourceRange.baseMipLevel = mip;
+                barrier.subresourceRange.levelCount = run;
+                barrier.subresourceRange.baseArrayLayer = layer;
+                // the same mips of the previous layer in the same state
+                // extend its barrier instead
+                VkImageMemoryBarrier* last = barriers_.empty() ? nullptr : &barriers_.back();
+                if (last != nullptr && last->image == image &&
+                    last->subresourceRange.baseMipLevel == mip &&
+                    last->subresourceRange.levelCount == run &&
+                    last->subresourceRange.baseArrayLayer + last->subresourceRange.layerCount == layer &&
+                    last->oldLayout == barrier.oldLayout &&
+                    last->newLayout == barrier.newLayout &&
+                    last->srcAccessMask == barrier.srcAccessMask &&
+                    last->dstAccessMask == barrier.dstAccessMask) {
+                    ++last->subresourceRange.layerCount;
+                }
+                else {
+                    barriers_.push_back(barrier);
+                }
+                srcStages_ |= srcStages;
+                dstStages_ |= info.stages;
+                ++queued;
+            }
+            for (uint32_t i = 0; i < run; ++i) {
+                states[mip + i] = next;
+            }
+            mip += run;
+        }
+    }
+    if (queued == 0) {
+        ++skipped_;
+    }
+}
+
+void ImageStateTracker::flush(VkCommandBuffer commandBuffer)
+{
+    if (barriers_.empty()) {
+        return;
+    }
+    vkCmdPipelineBarrier(commandBuffer,
+        srcStages_ != 0 ? srcStages_ : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStages_,
+        0,
+        0, nullptr,
+        0, nullptr,
+        static_cast<uint32_t>(barriers_.size()), barriers_.data());
+    recordedBarriers_ += barriers_.size();
+    ++pipelineBarrierCalls_;
+    clearPending();
+}
+
+void ImageStateTracker::clearPending()
+{
+    for (const VkImageMemoryBarrier& barrier : barriers_) {
+        TrackedImage& tracked = images_[barrier.image];
+        const VkImageSubresourceRange& range = barrier.subresourceRange;
+        for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+            for (uint32_t mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; ++mip) {
+                tracked.states[layer * tracked.mipLevels + mip].pending = false;
+            }
+        }
+    }
+    barriers_.clear();
+    srcStages_ = 0;
+    dstStages_ = 0;
+}
+
+VkImageLayout ImageStateTracker::layout(VkImage image, uint32_t mipLevel, uint32_t arrayLayer) const
+{
+    auto it = images_.find(image);
+    if (it == images_.end()) {
+        return VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    return it->second.states[arrayLayer * it->second.mipLevels + mipLevel].layout;
+}
+
+std::string ImageStateTracker::report() const
+{
+    char line[256];
+    snprintf(line, sizeof(line),
+        "image states: %u images, %llu transitions (%llu skipped), "
+        "%llu barriers in %llu calls\n",
+        static_cast<uint32_t>(images_.size()),
+        static_cast<unsigned long long>(requested_),
+        static_cast<unsigned long long>(skipped_),
+        static_cast<unsigned long long>(recordedBarriers_),
+        static_cast<unsigned long long>(pipelineBarrierCalls_));
+    return line;
+}
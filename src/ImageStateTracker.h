@@ -0,0 +1,107 @@
+#ifndef HAMON_IMAGE_STATE_TRACKER_H__
+#define HAMON_IMAGE_STATE_TRACKER_H__
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vulkan.h"
+
+// What the next commands do with an image, each maps to a layout, stages
+// and access
+enum ImageAccess {
+    IMAGE_ACCESS_TRANSFER_READ,
+    IMAGE_ACCESS_TRANSFER_WRITE,
+    IMAGE_ACCESS_COMPUTE_SAMPLED,
+    IMAGE_ACCESS_COMPUTE_STORAGE,
+    IMAGE_ACCESS_FRAGMENT_SAMPLED,
+    IMAGE_ACCESS_COLOR_ATTACHMENT,
+    IMAGE_ACCESS_DEPTH_ATTACHMENT,
+    IMAGE_ACCESS_PRESENT,
+    IMAGE_ACCESS_COUNT
+};
+
+// Remembers the layout, last write and readers of every mip and layer of the
+// images registered with it, so a transition names only the access it wants.
+// Subresources already there (a read after a read, a read of a write that
+// was already made visible to those stages) get no barrier; the rest are
+// queued and flush() records them all in one vkCmdPipelineBarrier.
+//
+// The state follows recording order, command buffers using the tracker must
+// be submitted in the order they were recorded.
+class ImageStateTracker {
+public:
+    // the image starts in initialLayout with no pending writes
+    void registerImage(VkImage image,
+        VkImageAspectFlags aspect,
+        uint32_t mipLevels,
+        uint32_t arrayLayers,
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+    // before the image is destroyed, drops pending barriers for it
+    void forgetImage(VkImage image);
+
+    // discard leaves the contents undefined, which lets the transition start
+    // from VK_IMAGE_LAYOUT_UNDEFINED
+    void transition(VkCommandBuffer commandBuffer,
+        VkImage image,
+        ImageAccess access,
+        bool discard = false);
+    void transition(VkCommandBuffer commandBuffer,
+        VkImage image,
+        uint32_t baseMipLevel,
+        uint32_t levelCount,
+        uint32_t baseArrayLayer,
+        uint32_t layerCount,
+        ImageAccess access,
+        bool discard = false);
+
+    // Records the queued barriers, call before the commands that need them.
+    // Transitioning a subresource that is already queued flushes the batch
+    // first, the two barriers can't share a call.
+    void flush(VkCommandBuffer commandBuffer);
+
+    VkImageLayout layout(VkImage image, uint32_t mipLevel = 0, uint32_t arrayLayer = 0) const;
+    bool isTracked(VkImage image) const { return images_.count(image) != 0; }
+
+    // since the tracker was created
+    uint64_t requestedTransitions() const { return requested_; }
+    uint64_t skippedTransitions() const { return skipped_; }
+    uint64_t recordedBarriers() const { return recordedBarriers_; }
+    uint64_t pipelineBarrierCalls() const { return pipelineBarrierCalls_; }
+
+    std::string report() const;
+private:
+    struct SubresourceState {
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStages;
+        VkAccessFlags writeAccess;
+        // stages that read since the last write
+        VkPipelineStageFlags readStages;
+        // stages the last write was made visible to
+        VkPipelineStageFlags visibleStages;
+        // has a barrier in the queued batch
+        bool pending;
+    };
+
+    struct TrackedImage {
+        VkImageAspectFlags aspect;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
+        // [layer * mipLevels + mip]
+        std::vector<SubresourceState> states;
+    };
+
+    static bool sameState(const SubresourceState& a, const SubresourceState& b);
+    void clearPending();
+private:
+    std::unordered_map<VkImage, TrackedImage> images_;
+    // queued by transition(), recorded by flush()
+    std::vector<VkImageMemoryBarrier> barriers_;
+    VkPipelineStageFlags srcStages_ = 0;
+    VkPipelineStageFlags dstStages_ = 0;
+    uint64_t requested_ = 0;
+    uint64_t skipped_ = 0;
+    uint64_t recordedBarriers_ = 0;
+    uint64_t pipelineBarrierCalls_ = 0;
+};
+
+#endif
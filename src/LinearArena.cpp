@@ -0,0 +1,45 @@
+#include "LinearArena.h"
+#include <assert.h>
+
+void LinearArena::reserve(size_t capacity)
+{
+    overflow_.clear();
+    buffer_.assign(capacity, 0);
+    offset_ = 0;
+    used_ = 0;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+    used_ += size;
+    uintptr_t base = reinterpret_cast<uintptr_t>(buffer_.data());
+    uintptr_t aligned = (base + offset_ + alignment - 1) & ~uintptr_t(alignment - 1);
+    size_t offset = static_cast<size_t>(aligned - base);
+    if (buffer_.size() >= size && offset <= buffer_.size() - size) {
+        offset_ = offset + size;
+        return buffer_.data() + offset;
+    }
+
+    // kept until reset, the arena is sized for it from then on
+    overflow_.emplace_back(new uint8_t[size + alignment]);
+    uintptr_t block = reinterpret_cast<uintptr_t>(overflow_.back().get());
+    return reinterpret_cast<void*>((block + alignment - 1) & ~uintptr_t(alignment - 1));
+}
+
+void LinearArena::reset()
+{
+    if (used_ > highWater_) {
+        highWater_ = used_;
+    }
+    if (!overflow_.empty()) {
+        // alignment padding isn't in used_, leave some room for it
+        size_t capacity = buffer_.empty() ? 4096 : buffer_.size();
+        while (capacity < highWater_ + highWater_ / 4) {
+            capacity *= 2;
+        }
+        reserve(capacity);
+    }
+    offset_ = 0;
+    used_ = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef HAMON_LINEAR_ARENA_H__
+#define HAMON_LINEAR_ARENA_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for transient CPU data. reset() drops everything at once and
+// no destructors run, so only trivially destructible types go in here.
+//
+// Running out of capacity falls back to a heap block (which shows up in the
+// allocation counters) and the next reset() grows the arena to the peak, so
+// after a few frames a steady workload never touches the heap.
+class LinearArena {
+public:
+    LinearArena() = default;
+    explicit LinearArena(size_t capacity) { reserve(capacity); }
+
+    // drops the content
+    void reserve(size_t capacity);
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template<typename T>
+    T* allocate(size_t count = 1)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "arena memory is released without running destructors");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void reset();
+
+    // bytes handed out since the last reset, overflow included
+    size_t used() const { return used_; }
+    size_t capacity() const { return buffer_.size(); }
+    // largest used() seen at a reset
+    size_t highWater() const { return highWater_; }
+private:
+    std::vector<uint8_t> buffer_;
+    size_t offset_ = 0;
+    size_t used_ = 0;
+    size_t highWater_ = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> overflow_;
+};
+#endif
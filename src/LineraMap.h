@@ -1,6 +1,8 @@
 #ifndef HAMON_LINERAMAP_H__
 #define HAMON_LINERAMAP_H__
 #include <vector>
+#include <utility>
+#include <cstddef>
 #include <assert.h>
 //A vector-like container which is indexed by K (instead of size_t as in std::vector).
 //Requires that K be convertible to size_t with the size_t operator (i.e. size_t()), and
@@ -35,8 +37,8 @@ class LinearMap {
         LinearMap() = default;
         LinearMap(const LinearMap&) = default;
         LinearMap(LinearMap&&) = default;
-        LinearMap& operator=(LinearMap&) = default;
-        LinearMap& operator=(linear_map&&) = default;
+        LinearMap& operator=(const LinearMap&) = default;
+        LinearMap& operator=(LinearMap&&) = default;
 
         //Vector-like constructors
         explicit LinearMap(size_t n) : vec_(n) {}
@@ -60,7 +62,7 @@ class LinearMap {
 
         //Indexing
         const_reference operator[] (const K n) const { 
-            TATUM_ASSERT_SAFE_MSG(size_t(n) < vec_.size(), "Out-of-range index");
+            assert(size_t(n) < vec_.size() && "Out-of-range index");
             return vec_[size_t(n)]; 
         }
 
@@ -125,7 +127,7 @@ class LinearMap {
         }
 
         //Swap (this enables std::swap via ADL)
-        friend void swap(linear_map<K,V>& x, linear_map<K,V>& y) {
+        friend void swap(LinearMap<K,V>& x, LinearMap<K,V>& y) {
             std::swap(x.vec_, y.vec_);
         }
     private:
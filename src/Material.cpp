@@ -0,0 +1,24 @@
+#include "Material.h"
+#include <string.h>
+
+void applyMaterial(const MaterialDesc& material, GraphicsPipelineDesc& pipeline)
+{
+    static_assert(SHADER_CONSTANT_COUNT <= MAX_PIPELINE_SPECIALIZATION_CONSTANTS,
+        "shader constants don't fit GraphicsPipelineDesc");
+    // unused values are zeroed so equal materials hash the same
+    memset(pipeline.specialization, 0, sizeof(pipeline.specialization));
+    pipeline.specializationCount = SHADER_CONSTANT_COUNT;
+    pipeline.specialization[SHADER_CONSTANT_HAS_TEXTURE] =
+        (material.features & MATERIAL_FEATURE_TEXTURE) ? VK_TRUE : VK_FALSE;
+    pipeline.specialization[SHADER_CONSTANT_VERTEX_COLOR] =
+        (material.features & MATERIAL_FEATURE_VERTEX_COLOR) ? VK_TRUE : VK_FALSE;
+    pipeline.specialization[SHADER_CONSTANT_ALPHA_TEST] =
+        (material.features & MATERIAL_FEATURE_ALPHA_TEST) ? VK_TRUE : VK_FALSE;
+    // the cutoff only matters with the alpha test, keep it out of the key
+    // otherwise
+    if (material.features & MATERIAL_FEATURE_ALPHA_TEST) {
+        memcpy(&pipeline.specialization[SHADER_CONSTANT_ALPHA_CUTOFF], &material.alphaCutoff, sizeof(float));
+    }
+    pipeline.blendMode = material.blendMode;
+    pipeline.cullMode = material.doubleSided ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+}
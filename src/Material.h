@@ -0,0 +1,37 @@
+#ifndef HAMON_MATERIAL_H__
+#define HAMON_MATERIAL_H__
+#include <stdint.h>
+#include "VulkanUtils.h"
+
+// specialization constant ids of shader.vert / shader.frag
+enum ShaderConstant {
+    SHADER_CONSTANT_HAS_TEXTURE,
+    SHADER_CONSTANT_VERTEX_COLOR,
+    SHADER_CONSTANT_ALPHA_TEST,
+    // float bits
+    SHADER_CONSTANT_ALPHA_CUTOFF,
+    SHADER_CONSTANT_COUNT
+};
+
+enum MaterialFeature {
+    // sample binding 1, white otherwise
+    MATERIAL_FEATURE_TEXTURE = 1 << 0,
+    // multiply by the vertex color
+    MATERIAL_FEATURE_VERTEX_COLOR = 1 << 1,
+    // discard below alphaCutoff
+    MATERIAL_FEATURE_ALPHA_TEST = 1 << 2,
+};
+
+struct MaterialDesc {
+    uint32_t features = MATERIAL_FEATURE_TEXTURE;
+    float alphaCutoff = 0.5f;
+    BlendMode blendMode = BLEND_MODE_OPAQUE;
+    bool doubleSided = false;
+};
+
+// Sets the specialization constants, blend and cull state of pipeline for
+// material. Features a material doesn't use are constant false in its
+// permutation, so the driver drops their code instead of branching on them.
+void applyMaterial(const MaterialDesc& material, GraphicsPipelineDesc& pipeline);
+
+#endif
@@ -0,0 +1,130 @@
+#include "MemoryStats.h"
+#include "VulkanExt.h"
+#include <stdio.h>
+#include <assert.h>
+
+namespace {
+
+const char* const CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "vertex",
+    "index",
+    "uniform",
+    "storage",
+    "texture",
+    "depth",
+    "staging",
+    "other",
+};
+
+} // namespace
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    return category < MEMORY_CATEGORY_COUNT ? CATEGORY_NAMES[category] : "unknown";
+}
+
+void MemoryStats::init(VkPhysicalDevice physicalDevice,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    bool memoryBudget)
+{
+    physicalDevice_ = physicalDevice;
+    memoryBudget_ = memoryBudget;
+    heapCount_ = memoryProperties.memoryHeapCount;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        memoryTypeHeaps_[i] = memoryProperties.memoryTypes[i].heapIndex;
+    }
+    for (uint32_t i = 0; i < heapCount_; ++i) {
+        heaps_[i] = {};
+        heaps_[i].size = memoryProperties.memoryHeaps[i].size;
+        heaps_[i].flags = memoryProperties.memoryHeaps[i].flags;
+    }
+    for (auto& category : categories_) {
+        category = {};
+    }
+    updateBudget();
+}
+
+void MemoryStats::recordAllocation(MemoryCategory category, uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    MemoryCategoryStats& stats = categories_[category];
+    stats.bytes += size;
+    stats.allocations++;
+    if (stats.bytes > stats.peakBytes) {
+        stats.peakBytes = stats.bytes;
+    }
+    heaps_[memoryTypeHeaps_[memoryTypeIndex]].allocatedBytes += size;
+}
+
+void MemoryStats::recordFree(MemoryCategory category, uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+    MemoryCategoryStats& stats = categories_[category];
+    assert(stats.bytes >= size && stats.allocations > 0);
+    stats.bytes -= size;
+    stats.allocations--;
+    heaps_[memoryTypeHeaps_[memoryTypeIndex]].allocatedBytes -= size;
+}
+
+void MemoryStats::updateBudget()
+{
+    if (!memoryBudget_) {
+        // no driver numbers, the same rule of thumb allocators use
+        for (uint32_t i = 0; i < heapCount_; ++i) {
+            heaps_[i].usage = heaps_[i].allocatedBytes;
+            heaps_[i].budget = heaps_[i].size / 10 * 8;
+        }
+        return;
+    }
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(physicalDevice_, &properties);
+    for (uint32_t i = 0; i < heapCount_; ++i) {
+        heaps_[i].usage = budget.heapUsage[i];
+        heaps_[i].budget = budget.heapBudget[i];
+    }
+}
+
+bool MemoryStats::overBudget(float fraction) const
+{
+    for (uint32_t i = 0; i < heapCount_; ++i) {
+        if (heaps_[i].budget != 0 && heaps_[i].usage > heaps_[i].budget * fraction) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string MemoryStats::report() const
+{
+    const double MB = 1024.0 * 1024.0;
+    std::string text;
+    char line[160];
+    snprintf(line, sizeof(line), "%-10s %8s %10s %10s\n", "memory", "count", "MB", "peak MB");
+    text += line;
+    for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i) {
+        const MemoryCategoryStats& stats = categories_[i];
+        if (stats.peakBytes == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "%-10s %8u %10.2f %10.2f\n",
+            CATEGORY_NAMES[i], stats.allocations, stats.bytes / MB, stats.peakBytes / MB);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %s\n",
+        "heap", "ours MB", "usage MB", "budget MB", "size MB", memoryBudget_ ? "" : "(estimated)");
+    text += line;
+    for (uint32_t i = 0; i < heapCount_; ++i) {
+        const MemoryHeapStats& heap = heaps_[i];
+        snprintf(line, sizeof(line), "%-10u %10.2f %10.2f %10.2f %10.2f %s\n",
+            i,
+            heap.allocatedBytes / MB,
+            heap.usage / MB,
+            heap.budget / MB,
+            heap.size / MB,
+            (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "device local" : "");
+        text += line;
+    }
+    return text;
+}
@@ -0,0 +1,71 @@
+#ifndef HAMON_MEMORY_STATS_H__
+#define HAMON_MEMORY_STATS_H__
+#include <stdint.h>
+#include <string>
+#include "vulkan.h"
+
+enum MemoryCategory {
+    MEMORY_CATEGORY_VERTEX,
+    MEMORY_CATEGORY_INDEX,
+    MEMORY_CATEGORY_UNIFORM,
+    MEMORY_CATEGORY_STORAGE,
+    MEMORY_CATEGORY_TEXTURE,
+    MEMORY_CATEGORY_DEPTH,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_OTHER,
+    MEMORY_CATEGORY_COUNT
+};
+
+struct MemoryCategoryStats {
+    VkDeviceSize bytes;
+    VkDeviceSize peakBytes;
+    uint32_t allocations;
+};
+
+struct MemoryHeapStats {
+    VkDeviceSize size;
+    VkMemoryHeapFlags flags;
+    // through recordAllocation
+    VkDeviceSize allocatedBytes;
+    // whole process as seen by the driver with VK_EXT_memory_budget,
+    // allocatedBytes and 80% of the heap size otherwise
+    VkDeviceSize usage;
+    VkDeviceSize budget;
+};
+
+// Device memory accounting. Every vkAllocateMemory of the renderer is
+// recorded with its category and memory type, usage against budget per heap
+// comes from VK_EXT_memory_budget when the device has it.
+class MemoryStats {
+public:
+    void init(VkPhysicalDevice physicalDevice,
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        bool memoryBudget);
+
+    void recordAllocation(MemoryCategory category, uint32_t memoryTypeIndex, VkDeviceSize size);
+    void recordFree(MemoryCategory category, uint32_t memoryTypeIndex, VkDeviceSize size);
+
+    // queries the driver, not free, call every few frames rather than every frame
+    void updateBudget();
+
+    // any heap using more than fraction of its budget, as of the last updateBudget()
+    bool overBudget(float fraction) const;
+
+    const MemoryCategoryStats& category(MemoryCategory category) const { return categories_[category]; }
+    uint32_t heapCount() const { return heapCount_; }
+    const MemoryHeapStats& heap(uint32_t index) const { return heaps_[index]; }
+    bool driverBudget() const { return memoryBudget_; }
+
+    std::string report() const;
+private:
+    VkPhysicalDevice physicalDevice_{VK_NULL_HANDLE};
+    bool memoryBudget_ = false;
+    uint32_t memoryTypeHeaps_[VK_MAX_MEMORY_TYPES] = {};
+    uint32_t heapCount_ = 0;
+    MemoryHeapStats heaps_[VK_MAX_MEMORY_HEAPS] = {};
+    MemoryCategoryStats categories_[MEMORY_CATEGORY_COUNT] = {};
+};
+
+const char* memoryCategoryName(MemoryCategory category);
+
+#endif
@@ -0,0 +1,170 @@
+#include "Mesh.h"
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+static const size_t MAX_16BIT_VERTICES = 1 << 16;
+
+uint32_t indexTypeSize(VkIndexType indexType)
+{
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+uint32_t Mesh::indexAt(uint32_t i) const
+{
+    assert(i < indexCount);
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        uint16_t index;
+        memcpy(&index, &indexData[i * sizeof(uint16_t)], sizeof(index));
+        return index;
+    }
+    uint32_t index;
+    memcpy(&index, &indexData[i * sizeof(uint32_t)], sizeof(index));
+    return index;
+}
+
+std::vector<uint32_t> Mesh::unpackIndices() const
+{
+    std::vector<uint32_t> result(indexCount);
+    for (const SubMesh& subMesh : subMeshes) {
+        for (uint32_t i = 0; i < subMesh.indexCount; ++i) {
+            uint32_t index = subMesh.firstIndex + i;
+            result[index] = indexAt(index) + subMesh.vertexOffset;
+        }
+    }
+    return result;
+}
+
+template<typename T>
+static void packIndices(std::vector<uint8_t>& out, const uint32_t* indices, size_t indexCount)
+{
+    out.resize(indexCount * sizeof(T));
+    T* dst = reinterpret_cast<T*>(out.data());
+    for (size_t i = 0; i < indexCount; ++i) {
+        dst[i] = static_cast<T>(indices[i]);
+    }
+}
+
+// Greedily groups triangles so that each group references at most 65536
+// vertices and gives every group its own contiguous vertex range.
+static void splitInto16BitChunks(Mesh& mesh,
+    const Vertex* vertices,
+    size_t vertexCount,
+    const uint32_t* indices,
+    size_t indexCount)
+{
+    std::vector<uint32_t> localIndex(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> chunkVertices;
+    std::vector<uint32_t> chunkIndices;
+    chunkIndices.reserve(indexCount);
+
+    SubMesh current = {};
+    auto flush = [&]() {
+        if (current.indexCount == 0) {
+            return;
+        }
+        for (uint32_t v : chunkVertices) {
+            mesh.vertices.push_back(vertices[v]);
+            localIndex[v] = UINT32_MAX;
+        }
+        chunkVertices.clear();
+        mesh.subMeshes.push_back(current);
+        current = {};
+        current.firstIndex = static_cast<uint32_t>(chunkIndices.size());
+        current.vertexOffset = static_cast<int32_t>(mesh.vertices.size());
+    };
+
+    for (size_t i = 0; i < indexCount; i += 3) {
+        size_t newVertices = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            newVertices += localIndex[indices[i + k]] == UINT32_MAX;
+        }
+        if (chunkVertices.size() + newVertices > MAX_16BIT_VERTICES) {
+            flush();
+        }
+        for (size_t k = 0; k < 3; ++k) {
+            uint32_t v = indices[i + k];
+            if (localIndex[v] == UINT32_MAX) {
+                localIndex[v] = static_cast<uint32_t>(chunkVertices.size());
+                chunkVertices.push_back(v);
+            }
+            chunkIndices.push_back(localIndex[v]);
+        }
+        current.indexCount += 3;
+    }
+    flush();
+
+    packIndices<uint16_t>(mesh.indexData, chunkIndices.data(), chunkIndices.size());
+}
+
+Mesh importMesh(const Vertex* vertices,
+    size_t vertexCount,
+    const uint32_t* indices,
+    size_t indexCount,
+    const MeshImportOptions& options)
+{
+    assert(indexCount % 3 == 0);
+    Mesh mesh;
+    mesh.indexCount = static_cast<uint32_t>(indexCount);
+    mesh.bounds.min = glm::vec3(0.f);
+    mesh.bounds.max = glm::vec3(0.f);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const glm::vec3& p = vertices[i].position;
+        mesh.bounds.min = i == 0 ? p : glm::min(mesh.bounds.min, p);
+        mesh.bounds.max = i == 0 ? p : glm::max(mesh.bounds.max, p);
+    }
+
+    if (vertexCount <= MAX_16BIT_VERTICES) {
+        mesh.indexType = VK_INDEX_TYPE_UINT16;
+        mesh.vertices.assign(vertices, vertices + vertexCount);
+        packIndices<uint16_t>(mesh.indexData, indices, indexCount);
+        mesh.subMeshes.push_back({0, mesh.indexCount, 0});
+    }
+    else if (options.split16BitChunks) {
+        mesh.indexType = VK_INDEX_TYPE_UINT16;
+        splitInto16BitChunks(mesh, vertices, vertexCount, indices, indexCount);
+    }
+    else {
+        mesh.indexType = VK_INDEX_TYPE_UINT32;
+        mesh.vertices.assign(vertices, vertices + vertexCount);
+        packIndices<uint32_t>(mesh.indexData, indices, indexCount);
+        mesh.subMeshes.push_back({0, mesh.indexCount, 0});
+    }
+    return mesh;
+}
+
+Mesh generateGridMesh(uint32_t triangleCount)
+{
+    assert(triangleCount > 0);
+    // smallest square grid with enough quads, the last row is cut short
+    uint32_t quadCount = (triangleCount + 1) / 2;
+    uint32_t cells = static_cast<uint32_t>(ceil(sqrt(static_cast<double>(quadCount))));
+    uint32_t rows = (quadCount + cells - 1) / cells;
+
+    std::vector<Vertex> gridVertices;
+    gridVertices.reserve((cells + 1) * (rows + 1));
+    for (uint32_t y = 0; y <= rows; ++y) {
+        for (uint32_t x = 0; x <= cells; ++x) {
+            Vertex vertex;
+            vertex.uv = glm::vec2(x / float(cells), y / float(cells));
+            vertex.position = glm::vec3(vertex.uv.x - 0.5f, vertex.uv.y - 0.5f, 0.f);
+            vertex.color = glm::vec3(1.f, 1.f, 1.f);
+            gridVertices.push_back(vertex);
+        }
+    }
+
+    std::vector<uint32_t> gridIndices;
+    gridIndices.reserve(triangleCount * 3);
+    for (uint32_t quad = 0; quad < quadCount; ++quad) {
+        uint32_t i0 = (quad / cells) * (cells + 1) + quad % cells;
+        uint32_t i1 = i0 + 1;
+        uint32_t i2 = i1 + cells + 1;
+        uint32_t i3 = i0 + cells + 1;
+        uint32_t quadIndices[6] = {i0, i1, i2, i2, i3, i0};
+        for (uint32_t i = 0; i < 6 && gridIndices.size() < triangleCount * 3; ++i) {
+            gridIndices.push_back(quadIndices[i]);
+        }
+    }
+    return importMesh(gridVertices.data(), gridVertices.size(),
+        gridIndices.data(), gridIndices.size());
+}
@@ -0,0 +1,54 @@
+#ifndef HAMON_MESH_H__
+#define HAMON_MESH_H__
+#include "Vertex.h"
+#include <stdint.h>
+#include <vector>
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// One vkCmdDrawIndexed worth of a mesh
+struct SubMesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t  vertexOffset;
+};
+
+struct MeshImportOptions {
+    // Meshes with more than 65536 vertices normally fall back to 32-bit
+    // indices. When set they are split into sub meshes that each address at
+    // most 65536 vertices through vertexOffset and keep 16-bit indices,
+    // vertices shared across a split are duplicated.
+    bool split16BitChunks = false;
+};
+
+struct Mesh {
+    std::vector<Vertex> vertices;
+    // packed uint16_t or uint32_t depending on indexType
+    std::vector<uint8_t> indexData;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+    uint32_t indexCount = 0;
+    std::vector<SubMesh> subMeshes;
+    Aabb bounds;
+
+    uint32_t indexAt(uint32_t i) const;
+    // absolute indices into vertices (vertexOffset applied), for tools such as
+    // the meshlet builder that work on plain 32-bit index lists
+    std::vector<uint32_t> unpackIndices() const;
+};
+
+uint32_t indexTypeSize(VkIndexType indexType);
+
+// Picks the narrowest index type that can address every vertex
+Mesh importMesh(const Vertex* vertices,
+    size_t vertexCount,
+    const uint32_t* indices,
+    size_t indexCount,
+    const MeshImportOptions& options = MeshImportOptions());
+
+// Unit quad in the xy plane tessellated into exactly triangleCount
+// triangles, used for synthetic benchmark scenes
+Mesh generateGridMesh(uint32_t triangleCount);
+#endif
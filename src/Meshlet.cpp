@@ -0,0 +1,177 @@
+#include "Meshlet.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+static glm::vec3 loadPosition(const float* positions, size_t stride, uint32_t index)
+{
+    const float* p = reinterpret_cast<const float*>(
+        reinterpret_cast<const uint8_t*>(positions) + stride * index);
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+static void computeMeshletBounds(Meshlet& meshlet,
+    const MeshletData& data,
+    const float* positions,
+    size_t positionStride)
+{
+    // bounding sphere: center of the aabb, radius to the farthest vertex
+    glm::vec3 minPos = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset]);
+    glm::vec3 maxPos = minPos;
+    for (uint32_t i = 1; i < meshlet.vertexCount; ++i) {
+        glm::vec3 p = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset + i]);
+        minPos = glm::min(minPos, p);
+        maxPos = glm::max(maxPos, p);
+    }
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+        glm::vec3 p = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset + i]);
+        radius = std::max(radius, glm::length(p - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // normal cone: average of the triangle normals, the cutoff is derived from
+    // the normal that deviates the most from the axis
+    glm::vec3 normals[MESHLET_MAX_TRIANGLES];
+    glm::vec3 corners[MESHLET_MAX_TRIANGLES];
+    uint32_t normalCount = 0;
+    glm::vec3 axis(0.f);
+    for (uint32_t i = 0; i < meshlet.triangleCount && normalCount < MESHLET_MAX_TRIANGLES; ++i) {
+        const uint8_t* tri = &data.triangles[meshlet.triangleOffset + i * 3];
+        glm::vec3 p0 = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset + tri[0]]);
+        glm::vec3 p1 = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset + tri[1]]);
+        glm::vec3 p2 = loadPosition(positions, positionStride, data.vertices[meshlet.vertexOffset + tri[2]]);
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        // degenerate triangles don't have a meaningful normal
+        if (area == 0.f) {
+            continue;
+        }
+        normals[normalCount] = n / area;
+        corners[normalCount] = p0;
+        axis += normals[normalCount];
+        ++normalCount;
+    }
+
+    meshlet.coneApex = glm::vec4(center, 0.f);
+    // cutoff of 1 with a zero axis never passes the backface test
+    meshlet.coneAxis = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    float axisLength = glm::length(axis);
+    if (normalCount == 0 || axisLength == 0.f) {
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.f;
+    for (uint32_t i = 0; i < normalCount; ++i) {
+        minDot = std::min(minDot, glm::dot(normals[i], axis));
+    }
+    // cone wider than ~90 degrees, culling would almost never succeed
+    if (minDot <= 0.1f) {
+        return;
+    }
+
+    // move the apex back along the axis so that every triangle plane is in
+    // front of it, this keeps the test conservative for perspective views
+    float maxT = 0.f;
+    for (uint32_t i = 0; i < normalCount; ++i) {
+        float dc = glm::dot(corners[i] - center, normals[i]);
+        float dn = glm::dot(axis, normals[i]);
+        maxT = std::max(maxT, dc / dn);
+    }
+    meshlet.coneApex = glm::vec4(center - axis * maxT, 0.f);
+    meshlet.coneAxis = glm::vec4(axis, sqrtf(1.f - minDot * minDot));
+}
+
+void buildMeshlets(MeshletData& out,
+    const uint32_t* indices,
+    size_t indexCount,
+    const float* positions,
+    size_t vertexCount,
+    size_t positionStride,
+    uint32_t maxVertices,
+    uint32_t maxTriangles)
+{
+    assert(indexCount % 3 == 0);
+    assert(maxVertices <= MESHLET_MAX_VERTICES && maxVertices >= 3);
+    assert(maxTriangles <= MESHLET_MAX_TRIANGLES && maxTriangles >= 1);
+
+    out.meshlets.clear();
+    out.vertices.clear();
+    out.triangles.clear();
+
+    // mesh vertex -> local index in the meshlet being built, 0xff if unused
+    std::vector<uint8_t> localIndex(vertexCount, 0xff);
+
+    Meshlet current = {};
+    auto flush = [&]() {
+        if (current.triangleCount == 0) {
+            return;
+        }
+        for (uint32_t i = 0; i < current.vertexCount; ++i) {
+            localIndex[out.vertices[current.vertexOffset + i]] = 0xff;
+        }
+        computeMeshletBounds(current, out, positions, positionStride);
+        out.meshlets.push_back(current);
+        current = {};
+        current.vertexOffset = static_cast<uint32_t>(out.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(out.triangles.size());
+    };
+
+    for (size_t i = 0; i < indexCount; i += 3) {
+        uint32_t a = indices[i + 0];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+        assert(a < vertexCount && b < vertexCount && c < vertexCount);
+
+        uint32_t newVertices = (localIndex[a] == 0xff) +
+            (localIndex[b] == 0xff) +
+            (localIndex[c] == 0xff);
+        if (current.vertexCount + newVertices > maxVertices ||
+            current.triangleCount + 1 > maxTriangles) {
+            flush();
+        }
+
+        uint32_t tri[3] = {a, b, c};
+        for (uint32_t v : tri) {
+            if (localIndex[v] == 0xff) {
+                localIndex[v] = static_cast<uint8_t>(current.vertexCount++);
+                out.vertices.push_back(v);
+            }
+            out.triangles.push_back(localIndex[v]);
+        }
+        current.triangleCount++;
+    }
+    flush();
+}
+
+std::vector<uint32_t> buildMeshletIndices(const MeshletData& data)
+{
+    std::vector<uint32_t> result(data.triangles.size());
+    for (const Meshlet& meshlet : data.meshlets) {
+        for (uint32_t i = 0; i < meshlet.triangleCount * 3; ++i) {
+            uint32_t local = data.triangles[meshlet.triangleOffset + i];
+            result[meshlet.triangleOffset + i] = data.vertices[meshlet.vertexOffset + local];
+        }
+    }
+    return result;
+}
+
+void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6])
+{
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) {
+        row[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+    }
+    planes[0] = row[3] + row[0];
+    planes[1] = row[3] - row[0];
+    planes[2] = row[3] + row[1];
+    planes[3] = row[3] - row[1];
+    planes[4] = row[2];
+    planes[5] = row[3] - row[2];
+    for (int i = 0; i < 6; ++i) {
+        float length = glm::length(glm::vec3(planes[i].x, planes[i].y, planes[i].z));
+        planes[i] = planes[i] * (1.f / length);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef HAMON_MESHLET_H__
+#define HAMON_MESHLET_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Limits match what most mesh shader implementations prefer and what
+// meshlet.mesh declares as max_vertices / max_primitives.
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Layout is shared with the shaders (std430), keep in sync with
+// meshlet.task / meshlet.mesh / meshlet_cull.comp.
+struct Meshlet {
+    glm::vec4 sphere;        // xyz: center, w: radius
+    glm::vec4 coneApex;      // xyz: apex
+    glm::vec4 coneAxis;      // xyz: axis, w: cutoff (cos of cone angle)
+    uint32_t vertexOffset;   // first entry in MeshletData::vertices
+    uint32_t triangleOffset; // first byte in MeshletData::triangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// Push constants of the culling shaders, planes and camera in object space
+struct MeshletCullConstants {
+    glm::vec4 frustumPlanes[6];
+    glm::vec4 cameraPosition;
+    uint32_t meshletCount;
+};
+
+struct MeshletData {
+    std::vector<Meshlet> meshlets;
+    // meshlet local vertex -> mesh vertex index
+    std::vector<uint32_t> vertices;
+    // 3 meshlet local vertex indices per triangle, tightly packed, so
+    // triangleOffset is also the first index of the meshlet in
+    // buildMeshletIndices()
+    std::vector<uint8_t> triangles;
+};
+
+// Greedily splits an indexed triangle list into clusters of at most
+// maxVertices / maxTriangles and computes a bounding sphere and a normal
+// cone for each of them. positionStride is the byte distance between two
+// consecutive positions (e.g. sizeof(Vertex)).
+void buildMeshlets(MeshletData& out,
+    const uint32_t* indices,
+    size_t indexCount,
+    const float* positions,
+    size_t vertexCount,
+    size_t positionStride,
+    uint32_t maxVertices = MESHLET_MAX_VERTICES,
+    uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// Expands the meshlets back into a plain index list in meshlet order, used
+// by the draw-indirect fallback when mesh shaders are not available.
+std::vector<uint32_t> buildMeshletIndices(const MeshletData& data);
+
+// Left, right, bottom, top, near, far planes (xyz: normal, w: distance) of a
+// Vulkan clip space [0, 1] depth projection, in the space the matrix maps from.
+void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]);
+
+#endif
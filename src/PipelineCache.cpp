@@ -0,0 +1,425 @@
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// no padding, hashing and comparing the bytes sees every field
+static_assert(sizeof(GraphicsPipelineDesc) ==
+    4 * sizeof(VkShaderModule) + (12 + MAX_PIPELINE_SPECIALIZATION_CONSTANTS) * sizeof(uint32_t),
+    "GraphicsPipelineDesc must not contain padding");
+
+// the state fields of a key line, subpass to specializationCount
+static const uint32_t KEY_STATE_FIELDS = 12;
+
+// non-dispatchable handles are pointers or uint64_t depending on the platform
+template<typename Handle>
+static uint64_t handleBits(Handle handle)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &handle, sizeof(handle));
+    return bits;
+}
+
+template<typename Handle>
+static Handle bitsHandle(uint64_t bits)
+{
+    Handle handle;
+    memcpy(&handle, &bits, sizeof(handle));
+    return handle;
+}
+
+// State a key file may ask for: valid enums, and nothing that needs a device
+// feature createDevice() doesn't enable (geometry / tessellation shaders for
+// the adjacency and patch topologies, fillModeNonSolid for other polygon
+// modes). Render passes have a single subpass.
+static bool validKeyState(const GraphicsPipelineDesc& desc)
+{
+    const uint32_t colorComponents = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    return desc.subpass == 0 &&
+        desc.vertexLayout < VERTEX_LAYOUT_COUNT &&
+        desc.topology <= VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN &&
+        desc.polygonMode == VK_POLYGON_MODE_FILL &&
+        desc.cullMode <= VK_CULL_MODE_FRONT_AND_BACK &&
+        desc.frontFace <= VK_FRONT_FACE_CLOCKWISE &&
+        desc.depthTest <= VK_TRUE &&
+        desc.depthWrite <= VK_TRUE &&
+        desc.depthCompareOp <= VK_COMPARE_OP_ALWAYS &&
+        desc.blendMode < BLEND_MODE_COUNT &&
+        (desc.colorWriteMask & ~colorComponents) == 0;
+}
+
+size_t PipelineCache::DescHash::operator()(const GraphicsPipelineDesc& desc) const
+{
+    // FNV-1a
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&desc);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(desc); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+bool PipelineCache::DescEqual::operator()(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b) const
+{
+    return memcmp(&a, &b, sizeof(GraphicsPipelineDesc)) == 0;
+}
+
+void PipelineCache::init(VkDevice device, ThreadPool* threadPool)
+{
+    device_ = device;
+    threadPool_ = threadPool;
+    VkPipelineCacheCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    info.pNext = nullptr;
+    info.flags = 0;
+    info.initialDataSize = 0;
+    info.pInitialData = nullptr;
+    VK_CHECK(vkCreatePipelineCache(device, &info, hostAllocator(), &vkCache_));
+}
+
+void PipelineCache::shutdown()
+{
+    std::vector<std::future<void>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // queued tasks find their entry taken and return right away
+        for (Entry& entry : entries_) {
+            if (entry.state == ENTRY_QUEUED) {
+                entry.state = ENTRY_CANCELLED;
+                --pending_;
+            }
+        }
+        tasks.swap(tasks_);
+    }
+    compiled_.notify_all();
+    for (std::future<void>& task : tasks) {
+        task.wait();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Entry& entry : entries_) {
+        if (entry.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device_, entry.pipeline, hostAllocator());
+        }
+    }
+    entries_.clear();
+    compiledCount_ = 0;
+    ids_.clear();
+    names_.clear();
+    handles_.clear();
+    if (vkCache_ != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(device_, vkCache_, hostAllocator());
+        vkCache_ = VK_NULL_HANDLE;
+    }
+}
+
+PipelineCache::PipelineId PipelineCache::requestGraphics(const GraphicsPipelineDesc& desc)
+{
+    PipelineId id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++requests_;
+        auto it = ids_.find(desc);
+        if (it != ids_.end()) {
+            ++hits_;
+            return it->second;
+        }
+        id = static_cast<PipelineId>(entries_.size());
+        Entry entry = {desc, VK_NULL_HANDLE, ENTRY_QUEUED};
+        entries_.push_back(entry);
+        ids_.emplace(desc, id);
+        ++pending_;
+        if (threadPool_ != nullptr) {
+            // drop the finished tasks so the list stays short
+            for (size_t i = 0; i < tasks_.size(); ) {
+                if (tasks_[i].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    tasks_[i] = std::move(tasks_.back());
+                    tasks_.pop_back();
+                    continue;
+                }
+                ++i;
+            }
+            tasks_.push_back(threadPool_->submit([this, id] { compile(id); }));
+            return id;
+        }
+    }
+    compile(id);
+    return id;
+}
+
+PipelineCache::PipelineId PipelineCache::getGraphics(const GraphicsPipelineDesc& desc)
+{
+    PipelineId id = requestGraphics(desc);
+    wait(id);
+    return id;
+}
+
+void PipelineCache::wait(PipelineId id)
+{
+    // waiting on a task still in the queue could deadlock a worker calling
+    // this, take the compile instead
+    compile(id);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // shutdown() may have cleared the entries before this wakes up
+    compiled_.wait(lock, [this, id] {
+        return id >= entries_.size()
+            || entries_[id].state == ENTRY_READY
+            || entries_[id].state == ENTRY_CANCELLED;
+    });
+}
+
+void PipelineCache::compile(PipelineId id)
+{
+    GraphicsPipelineDesc desc;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[id];
+        if (entry.state != ENTRY_QUEUED) {
+            return;
+        }
+        entry.state = ENTRY_COMPILING;
+        desc = entry.desc;
+    }
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    {
+        HAMON_TRACE_SCOPE("compile pipeline");
+        // VkPipelineCache is internally synchronized
+        pipeline = createGraphicsPipeline(device_, desc, vkCache_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[id];
+        entry.pipeline = pipeline;
+        entry.state = ENTRY_READY;
+        --pending_;
+        ++compiledCount_;
+    }
+    compiled_.notify_all();
+}
+
+VkPipeline PipelineCache::pipeline(PipelineId id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[id].pipeline;
+}
+
+VkPipeline PipelineCache::pipelineOr(PipelineId id, PipelineId fallback) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    VkPipeline pipeline = entries_[id].pipeline;
+    return pipeline != VK_NULL_HANDLE ? pipeline : entries_[fallback].pipeline;
+}
+
+void PipelineCache::setName(uint64_t handle, const char* name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_[handle] = name;
+    handles_[name] = handle;
+}
+
+void PipelineCache::nameShader(VkShaderModule shader, const char* name)
+{
+    setName(handleBits(shader), name);
+}
+
+void PipelineCache::nameLayout(VkPipelineLayout layout, const char* name)
+{
+    setName(handleBits(layout), name);
+}
+
+void PipelineCache::nameRenderPass(VkRenderPass renderPass, const char* name)
+{
+    setName(handleBits(renderPass), name);
+}
+
+std::string PipelineCache::nameOf(uint64_t handle) const
+{
+    if (handle == 0) {
+        return "-";
+    }
+    auto it = names_.find(handle);
+    return it != names_.end() ? it->second : std::string();
+}
+
+bool PipelineCache::handleOf(const std::string& name, uint64_t& handle) const
+{
+    if (name == "-") {
+        handle = 0;
+        return true;
+    }
+    auto it = handles_.find(name);
+    if (it == handles_.end()) {
+        return false;
+    }
+    handle = it->second;
+    return true;
+}
+
+uint32_t PipelineCache::prewarm(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    std::vector<GraphicsPipelineDesc> descs;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char names[4][128];
+        int consumed = 0;
+        if (sscanf(line, "%127s %127s %127s %127s%n",
+                names[0], names[1], names[2], names[3], &consumed) != 4) {
+            continue;
+        }
+        uint64_t handles[4];
+        bool known = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (uint32_t i = 0; i < 4 && known; ++i) {
+                known = handleOf(names[i], handles[i]);
+            }
+        }
+        if (!known) {
+            continue;
+        }
+
+        uint32_t fields[KEY_STATE_FIELDS + MAX_PIPELINE_SPECIALIZATION_CONSTANTS] = {};
+        const char* cursor = line + consumed;
+        uint32_t count = 0;
+        while (count < ARRAY_SIZE(fields)) {
+            char* end = nullptr;
+            unsigned long value = strtoul(cursor, &end, 10);
+            // out of range leaves count short and the line is skipped
+            if (end == cursor || value > UINT32_MAX) {
+                break;
+            }
+            fields[count++] = static_cast<uint32_t>(value);
+            cursor = end;
+        }
+        uint32_t specializationCount = fields[KEY_STATE_FIELDS - 1];
+        if (count < KEY_STATE_FIELDS ||
+            specializationCount > MAX_PIPELINE_SPECIALIZATION_CONSTANTS ||
+            count != KEY_STATE_FIELDS + specializationCount) {
+            continue;
+        }
+
+        GraphicsPipelineDesc desc;
+        desc.vertexShader = bitsHandle<VkShaderModule>(handles[0]);
+        desc.fragmentShader = bitsHandle<VkShaderModule>(handles[1]);
+        desc.layout = bitsHandle<VkPipelineLayout>(handles[2]);
+        desc.renderPass = bitsHandle<VkRenderPass>(handles[3]);
+        desc.subpass = fields[0];
+        desc.vertexLayout = fields[1];
+        desc.topology = fields[2];
+        desc.polygonMode = fields[3];
+        desc.cullMode = fields[4];
+        desc.frontFace = fields[5];
+        desc.depthTest = fields[6];
+        desc.depthWrite = fields[7];
+        desc.depthCompareOp = fields[8];
+        desc.blendMode = fields[9];
+        desc.colorWriteMask = fields[10];
+        desc.specializationCount = specializationCount;
+        for (uint32_t i = 0; i < specializationCount; ++i) {
+            desc.specialization[i] = fields[KEY_STATE_FIELDS + i];
+        }
+        // stale or edited files are skipped line by line, like unknown names
+        if (!validKeyState(desc)) {
+            continue;
+        }
+        descs.push_back(desc);
+    }
+    fclose(file);
+
+    for (const GraphicsPipelineDesc& desc : descs) {
+        requestGraphics(desc);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    prewarmed_ += static_cast<uint32_t>(descs.size());
+    return static_cast<uint32_t>(descs.size());
+}
+
+bool PipelineCache::saveKeys(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Entry& entry : entries_) {
+        if (entry.pipeline == VK_NULL_HANDLE) {
+            continue;
+        }
+        const GraphicsPipelineDesc& desc = entry.desc;
+        std::string names[4] = {
+            nameOf(handleBits(desc.vertexShader)),
+            nameOf(handleBits(desc.fragmentShader)),
+            nameOf(handleBits(desc.layout)),
+            nameOf(handleBits(desc.renderPass)),
+        };
+        if (names[0].empty() || names[1].empty() || names[2].empty() || names[3].empty()) {
+            continue;
+        }
+        fprintf(file, "%s %s %s %s %u %u %u %u %u %u %u %u %u %u %u %u",
+            names[0].c_str(), names[1].c_str(), names[2].c_str(), names[3].c_str(),
+            desc.subpass,
+            desc.vertexLayout,
+            desc.topology,
+            desc.polygonMode,
+            desc.cullMode,
+            desc.frontFace,
+            desc.depthTest,
+            desc.depthWrite,
+            desc.depthCompareOp,
+            desc.blendMode,
+            desc.colorWriteMask,
+            desc.specializationCount);
+        for (uint32_t i = 0; i < desc.specializationCount; ++i) {
+            fprintf(file, " %u", desc.specialization[i]);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return true;
+}
+
+uint32_t PipelineCache::pipelineCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return compiledCount_;
+}
+
+uint32_t PipelineCache::pendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+uint64_t PipelineCache::requestCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+}
+
+uint64_t PipelineCache::hitCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::string PipelineCache::report() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    char line[256];
+    snprintf(line, sizeof(line),
+        "pipelines: %u compiled, %u compiling, %llu requests (%llu shared), %u prewarmed\n",
+        compiledCount_,
+        pending_,
+        static_cast<unsigned long long>(requests_),
+        static_cast<unsigned long long>(hits_),
+        prewarmed_);
+    return line;
+}
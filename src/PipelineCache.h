@@ -0,0 +1,119 @@
+#ifndef HAMON_PIPELINE_CACHE_H__
+#define HAMON_PIPELINE_CACHE_H__
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "VulkanUtils.h"
+
+class ThreadPool;
+
+// Graphics pipelines keyed by their GraphicsPipelineDesc. Identical requests
+// share one pipeline, so a scene with many materials only compiles the
+// distinct permutations. Pipelines live until shutdown(). Compilation goes
+// through one VkPipelineCache so the driver can reuse work between
+// permutations of the same shaders.
+//
+// requestGraphics() never blocks: new pipelines compile on the thread pool
+// and pipeline() is VK_NULL_HANDLE until they are done, draws then skip or
+// use a fallback. The descs compiled in a run can be saved as a key list and
+// prewarmed by the next one, so first use of a material doesn't hitch.
+class PipelineCache {
+public:
+    typedef uint32_t PipelineId;
+
+    // without a thread pool requests compile on the calling thread
+    void init(VkDevice device, ThreadPool* threadPool);
+    // drops queued compiles and waits for running ones, the device must be idle
+    void shutdown();
+
+    // thread safe
+    PipelineId requestGraphics(const GraphicsPipelineDesc& desc);
+    // requestGraphics() and wait() in one, compiles on the calling thread if
+    // no worker picked the pipeline up yet
+    PipelineId getGraphics(const GraphicsPipelineDesc& desc);
+    // also returns once shutdown() dropped the compile, pipeline() stays
+    // VK_NULL_HANDLE then
+    void wait(PipelineId id);
+
+    // VK_NULL_HANDLE while compiling
+    VkPipeline pipeline(PipelineId id) const;
+    bool isReady(PipelineId id) const { return pipeline(id) != VK_NULL_HANDLE; }
+    // id's pipeline if it is ready, fallback's otherwise
+    VkPipeline pipelineOr(PipelineId id, PipelineId fallback) const;
+
+    // Saved keys refer to shaders, layouts and render passes by these names,
+    // handles change from run to run. Names must not contain whitespace.
+    void nameShader(VkShaderModule shader, const char* name);
+    void nameLayout(VkPipelineLayout layout, const char* name);
+    void nameRenderPass(VkRenderPass renderPass, const char* name);
+
+    // Requests every pipeline of a key list written by saveKeys() whose
+    // names are all known and whose state is valid for this device, returns
+    // how many. A missing file is no error.
+    uint32_t prewarm(const char* path);
+    // the ready pipelines with named objects, one per line
+    bool saveKeys(const char* path) const;
+
+    uint32_t pipelineCount() const;
+    uint32_t pendingCount() const;
+    uint64_t requestCount() const;
+    // requests answered by an existing pipeline
+    uint64_t hitCount() const;
+
+    std::string report() const;
+private:
+    struct DescHash {
+        size_t operator()(const GraphicsPipelineDesc& desc) const;
+    };
+    struct DescEqual {
+        bool operator()(const GraphicsPipelineDesc& a, const GraphicsPipelineDesc& b) const;
+    };
+
+    enum EntryState {
+        ENTRY_QUEUED,
+        ENTRY_COMPILING,
+        ENTRY_READY,
+        // dropped by shutdown() before it compiled, pipeline stays null
+        ENTRY_CANCELLED,
+    };
+
+    struct Entry {
+        GraphicsPipelineDesc desc;
+        VkPipeline pipeline;
+        EntryState state;
+    };
+
+    // compiles id unless another thread took it first
+    void compile(PipelineId id);
+    void setName(uint64_t handle, const char* name);
+    // "-" for VK_NULL_HANDLE, empty if the handle has no name
+    std::string nameOf(uint64_t handle) const;
+    // false if the name is unknown
+    bool handleOf(const std::string& name, uint64_t& handle) const;
+private:
+    VkDevice device_{VK_NULL_HANDLE};
+    ThreadPool* threadPool_ = nullptr;
+    VkPipelineCache vkCache_{VK_NULL_HANDLE};
+    mutable std::mutex mutex_;
+    std::condition_variable compiled_;
+    std::unordered_map<GraphicsPipelineDesc, PipelineId, DescHash, DescEqual> ids_;
+    // indexed by PipelineId, never moves
+    std::deque<Entry> entries_;
+    // of the compile tasks handed to the thread pool
+    std::vector<std::future<void>> tasks_;
+    uint32_t pending_ = 0;
+    // entries in ENTRY_READY, cancelled ones are neither
+    uint32_t compiledCount_ = 0;
+    std::unordered_map<uint64_t, std::string> names_;
+    std::unordered_map<std::string, uint64_t> handles_;
+    uint64_t requests_ = 0;
+    uint64_t hits_ = 0;
+    uint32_t prewarmed_ = 0;
+};
+
+#endif
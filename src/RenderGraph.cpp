@@ -0,0 +1,591 @@
+#include "RenderGraph.h"
+#include "VulkanUtils.h"
+#include "GpuResources.h"
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+
+struct UsageInfo {
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    bool write;
+};
+
+// indexed by RenderGraphUsage
+static const UsageInfo USAGE_INFOS[RENDER_GRAPH_USAGE_COUNT] = {
+    {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, false},
+    {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false},
+    {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true},
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, false},
+    {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, true},
+    {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, false},
+    {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false},
+    {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true},
+    {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true},
+    // the stage the acquire semaphore is waited at, so barriers out of it
+    // chain with the wait
+    {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false},
+};
+
+static const uint32_t NO_PASS = UINT32_MAX;
+
+void RenderGraph::init(VkDevice device,
+    GpuResources* resources,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    bool synchronization2)
+{
+    device_ = device;
+    gpuResources_ = resources;
+    memoryProperties_ = memoryProperties;
+    synchronization2_ = synchronization2;
+}
+
+void RenderGraph::shutdown()
+{
+    for (Resource& resource : resources_) {
+        if (resource.imported || resource.vkImage == VK_NULL_HANDLE) {
+            continue;
+        }
+        vkDestroyImageView(device_, resource.view, hostAllocator());
+        vkDestroyImage(device_, resource.vkImage, hostAllocator());
+        resource.view = VK_NULL_HANDLE;
+        resource.vkImage = VK_NULL_HANDLE;
+    }
+    for (const MemoryBlock& block : blocks_) {
+        vkFreeMemory(device_, block.memory, hostAllocator());
+        gpuResources_->memoryStats().recordFree(block.category, block.memoryTypeIndex, block.size);
+    }
+    blocks_.clear();
+    passes_.clear();
+    resources_.clear();
+    compiled_ = false;
+}
+
+RenderGraph::ResourceId RenderGraph::importImage(const char* name,
+    VkImageAspectFlags aspect,
+    RenderGraphUsage initialUsage,
+    RenderGraphUsage finalUsage,
+    bool preserveContents)
+{
+    assert(!compiled_);
+    Resource resource = {};
+    resource.name = name;
+    resource.image = true;
+    resource.imported = true;
+    resource.aspect = aspect;
+    resource.initialUsage = initialUsage;
+    resource.finalUsage = finalUsage;
+    resource.preserveContents = preserveContents;
+    resource.block = UINT32_MAX;
+    resources_.push_back(resource);
+    return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::importBuffer(const char* name)
+{
+    assert(!compiled_);
+    Resource resource = {};
+    resource.name = name;
+    resource.image = false;
+    resource.imported = true;
+    resource.initialUsage = RENDER_GRAPH_USAGE_NONE;
+    resource.finalUsage = RENDER_GRAPH_USAGE_NONE;
+    resource.preserveContents = true;
+    resource.block = UINT32_MAX;
+    resources_.push_back(resource);
+    return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::createTransientImage(const char* name, const TransientImageDesc& desc)
+{
+    assert(!compiled_);
+    Resource resource = {};
+    resource.name = name;
+    resource.image = true;
+    resource.imported = false;
+    resource.aspect = desc.aspect;
+    resource.initialUsage = RENDER_GRAPH_USAGE_NONE;
+    resource.finalUsage = RENDER_GRAPH_USAGE_NONE;
+    resource.preserveContents = false;
+    resource.transient = desc;
+    resource.block = UINT32_MAX;
+    resources_.push_back(resource);
+    return static_cast<ResourceId>(resources_.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::addPass(const char* name, PassCallback callback)
+{
+    assert(!compiled_);
+    Pass pass = {};
+    pass.name = name;
+    pass.callback = std::move(callback);
+    pass.live = true;
+    passes_.push_back(std::move(pass));
+    return static_cast<PassId>(passes_.size() - 1);
+}
+
+void RenderGraph::addAccess(PassId pass, ResourceId resource, RenderGraphUsage usage)
+{
+    assert(!compiled_);
+    // barriers of one batch aren't ordered among themselves
+    for (const Access& access : passes_[pass].accesses) {
+        assert(access.resource != resource);
+        (void)access;
+    }
+    passes_[pass].accesses.push_back({resource, usage});
+}
+
+void RenderGraph::read(PassId pass, ResourceId resource, RenderGraphUsage usage)
+{
+    assert(!USAGE_INFOS[usage].write);
+    addAccess(pass, resource, usage);
+}
+
+void RenderGraph::write(PassId pass, ResourceId resource, RenderGraphUsage usage)
+{
+    assert(USAGE_INFOS[usage].write);
+    addAccess(pass, resource, usage);
+}
+
+void RenderGraph::markOutput(ResourceId resource)
+{
+    resources_[resource].output = true;
+}
+
+void RenderGraph::cullPasses()
+{
+    // walking backwards, a pass is needed when it writes something a later
+    // needed pass reads or the frame outputs
+    std::vector<bool> needed(resources_.size());
+    for (size_t i = 0; i < resources_.size(); ++i) {
+        needed[i] = resources_[i].output;
+    }
+    for (size_t p = passes_.size(); p-- > 0; ) {
+        Pass& pass = passes_[p];
+        bool writes = false;
+        bool live = false;
+        for (const Access& access : pass.accesses) {
+            if (USAGE_INFOS[access.usage].write) {
+                writes = true;
+                live = live || needed[access.resource];
+            }
+        }
+        // nothing declared written, the pass may have side effects
+        pass.live = live || !writes;
+        if (!pass.live) {
+            continue;
+        }
+        for (const Access& access : pass.accesses) {
+            if (!USAGE_INFOS[access.usage].write) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::allocateTransients()
+{
+    struct Placement {
+        ResourceId resource;
+        VkMemoryRequirements requirements;
+    };
+    std::vector<Placement> placements;
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        Resource& resource = resources_[id];
+        if (resource.imported || resource.firstPass == NO_PASS) {
+            continue;
+        }
+        const TransientImageDesc& desc = resource.transient;
+        resource.vkImage = createImage2D(device_, desc.format, desc.usage, desc.width, desc.height, 1, 1);
+        Placement placement = {id, {}};
+        vkGetImageMemoryRequirements(device_, resource.vkImage, &placement.requirements);
+        unaliasedTransientBytes_ += placement.requirements.size;
+        placements.push_back(placement);
+    }
+
+    // largest first, each block's first image decides its size
+    std::sort(placements.begin(), placements.end(), [](const Placement& a, const Placement& b) {
+        return a.requirements.size > b.requirements.size;
+    });
+    std::vector<std::vector<ResourceId>> occupants;
+    for (const Placement& placement : placements) {
+        Resource& resource = resources_[placement.resource];
+        uint32_t found = UINT32_MAX;
+        for (uint32_t b = 0; b < blocks_.size() && found == UINT32_MAX; ++b) {
+            if ((blocks_[b].memoryTypeBits & placement.requirements.memoryTypeBits) == 0) {
+                continue;
+            }
+            bool overlaps = false;
+            for (ResourceId other : occupants[b]) {
+                const Resource& occupant = resources_[other];
+                overlaps = overlaps ||
+                    (resource.firstPass <= occupant.lastPass && occupant.firstPass <= resource.lastPass);
+            }
+            if (!overlaps) {
+                found = b;
+            }
+        }
+        if (found == UINT32_MAX) {
+            MemoryBlock block = {};
+            block.size = placement.requirements.size;
+            block.memoryTypeBits = placement.requirements.memoryTypeBits;
+            block.category = resource.transient.category;
+            blocks_.push_back(block);
+            occupants.emplace_back();
+            found = static_cast<uint32_t>(blocks_.size() - 1);
+        }
+        blocks_[found].memoryTypeBits &= placement.requirements.memoryTypeBits;
+        occupants[found].push_back(placement.resource);
+        resource.block = found;
+    }
+
+    for (uint32_t b = 0; b < blocks_.size(); ++b) {
+        MemoryBlock& block = blocks_[b];
+        block.memoryTypeIndex = findMemoryType(memoryProperties_, block.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.pNext = nullptr;
+        allocInfo.allocationSize = block.size;
+        allocInfo.memoryTypeIndex = block.memoryTypeIndex;
+        VK_CHECK(vkAllocateMemory(device_, &allocInfo, hostAllocator(), &block.memory));
+        gpuResources_->memoryStats().recordAllocation(block.category, block.memoryTypeIndex, block.size);
+        transientBytes_ += block.size;
+
+        // in the order they are used, the first one follows the last of the
+        // previous frame
+        std::vector<ResourceId>& users = occupants[b];
+        std::sort(users.begin(), users.end(), [this](ResourceId a, ResourceId c) {
+            return resources_[a].firstPass < resources_[c].firstPass;
+        });
+        for (size_t i = 0; i < users.size(); ++i) {
+            Resource& resource = resources_[users[i]];
+            resource.previousInBlock = users[(i + users.size() - 1) % users.size()];
+            VK_CHECK(vkBindImageMemory(device_, resource.vkImage, block.memory, 0));
+            resource.view = createImageView2D(device_, resource.vkImage,
+                resource.aspect, resource.transient.format);
+        }
+    }
+}
+
+RenderGraph::State RenderGraph::initialState(ResourceId id, const std::vector<State>& endStates) const
+{
+    const Resource& resource = resources_[id];
+    State state = {};
+    if (!resource.imported) {
+        // whatever used the memory last, in this frame or the previous one
+        state = endStates[resource.previousInBlock];
+    }
+    else if (resource.initialUsage == RENDER_GRAPH_USAGE_NONE) {
+        state = endStates[id];
+    }
+    else {
+        const UsageInfo& info = USAGE_INFOS[resource.initialUsage];
+        state.layout = info.layout;
+        if (info.write) {
+            state.writeStages = info.stage;
+            state.writeAccess = info.access;
+        }
+        else {
+            state.readStages = info.stage;
+        }
+    }
+    if (!resource.preserveContents) {
+        state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    return state;
+}
+
+void RenderGraph::buildBarrier(ResourceId id, RenderGraphUsage usage, State& state, bool record)
+{
+    const Resource& resource = resources_[id];
+    const UsageInfo& info = USAGE_INFOS[usage];
+    bool layoutChange = resource.image && state.layout != info.layout;
+    bool needed = layoutChange;
+    if (info.write) {
+        // write after write and write after read
+        needed = needed || state.writeStages != 0 || state.readStages != 0;
+    }
+    else {
+        // read after a write this stage hasn't seen yet
+        needed = needed || (state.writeStages != 0 && (info.stage & ~state.visibleStages) != 0);
+    }
+
+    if (needed && record) {
+        // a layout transition writes the image, earlier readers must be done
+        VkPipelineStageFlags2 srcStages = state.writeStages;
+        if (info.write || layoutChange) {
+            srcStages |= state.readStages;
+        }
+        if (resource.image) {
+            VkImageMemoryBarrier2 barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.pNext = nullptr;
+            barrier.srcStageMask = srcStages;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstStageMask = info.stage;
+            barrier.dstAccessMask = info.access;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = info.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = VK_NULL_HANDLE;
+            barrier.subresourceRange.aspectMask = resource.aspect;
+            // depth / stencil formats transition both aspects together
+            if (!resource.imported && hasStencilComponent(resource.transient.format)) {
+                barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            imageBarriers_.push_back(barrier);
+            imageBarrierResources_.push_back(id);
+        }
+        else {
+            VkBufferMemoryBarrier2 barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            barrier.pNext = nullptr;
+            barrier.srcStageMask = srcStages;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstStageMask = info.stage;
+            barrier.dstAccessMask = info.access;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = VK_NULL_HANDLE;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            bufferBarriers_.push_back(barrier);
+            bufferBarrierResources_.push_back(id);
+        }
+    }
+
+    if (info.write) {
+        state.writeStages = info.stage;
+        state.writeAccess = info.access;
+        state.readStages = 0;
+        state.visibleStages = 0;
+    }
+    else {
+        if (needed) {
+            state.visibleStages |= info.stage;
+        }
+        state.readStages |= info.stage;
+    }
+    if (resource.image) {
+        state.layout = info.layout;
+    }
+}
+
+void RenderGraph::simulate(std::vector<State>& states, bool record)
+{
+    for (Pass& pass : passes_) {
+        if (!pass.live) {
+            continue;
+        }
+        pass.firstImageBarrier = static_cast<uint32_t>(imageBarriers_.size());
+        pass.firstBufferBarrier = static_cast<uint32_t>(bufferBarriers_.size());
+        for (const Access& access : pass.accesses) {
+            buildBarrier(access.resource, access.usage, states[access.resource], record);
+        }
+        pass.imageBarrierCount = static_cast<uint32_t>(imageBarriers_.size()) - pass.firstImageBarrier;
+        pass.bufferBarrierCount = static_cast<uint32_t>(bufferBarriers_.size()) - pass.firstBufferBarrier;
+    }
+    finalImageBarrier_ = static_cast<uint32_t>(imageBarriers_.size());
+    finalBufferBarrier_ = static_cast<uint32_t>(bufferBarriers_.size());
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        if (resources_[id].finalUsage != RENDER_GRAPH_USAGE_NONE) {
+            buildBarrier(id, resources_[id].finalUsage, states[id], record);
+        }
+    }
+    finalImageBarrierCount_ = static_cast<uint32_t>(imageBarriers_.size()) - finalImageBarrier_;
+    finalBufferBarrierCount_ = static_cast<uint32_t>(bufferBarriers_.size()) - finalBufferBarrier_;
+}
+
+void RenderGraph::compile()
+{
+    assert(!compiled_);
+    cullPasses();
+    for (Resource& resource : resources_) {
+        resource.firstPass = NO_PASS;
+        resource.lastPass = 0;
+    }
+    for (PassId p = 0; p < passes_.size(); ++p) {
+        if (!passes_[p].live) {
+            continue;
+        }
+        for (const Access& access : passes_[p].accesses) {
+            Resource& resource = resources_[access.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+        }
+    }
+    allocateTransients();
+
+    // a dry run from an empty state finds where every resource ends the
+    // frame, which is where the next frame picks it up
+    std::vector<State> endStates(resources_.size(), State());
+    simulate(endStates, false);
+    std::vector<State> states(resources_.size());
+    for (ResourceId id = 0; id < resources_.size(); ++id) {
+        states[id] = initialState(id, endStates);
+    }
+    simulate(states, true);
+
+    size_t maxImageBarriers = 0;
+    size_t maxBufferBarriers = 0;
+    for (const Pass& pass : passes_) {
+        if (pass.live) {
+            maxImageBarriers = std::max<size_t>(maxImageBarriers, pass.imageBarrierCount);
+            maxBufferBarriers = std::max<size_t>(maxBufferBarriers, pass.bufferBarrierCount);
+        }
+    }
+    legacyImageBarriers_.resize(std::max<size_t>(maxImageBarriers, finalImageBarrierCount_));
+    legacyBufferBarriers_.resize(std::max<size_t>(maxBufferBarriers, finalBufferBarrierCount_));
+    compiled_ = true;
+}
+
+void RenderGraph::setImage(ResourceId resource, VkImage image)
+{
+    assert(resources_[resource].imported && resources_[resource].image);
+    resources_[resource].vkImage = image;
+}
+
+void RenderGraph::setBuffer(ResourceId resource, VkBuffer buffer)
+{
+    assert(resources_[resource].imported && !resources_[resource].image);
+    resources_[resource].buffer = buffer;
+}
+
+VkImageView RenderGraph::imageView(ResourceId resource) const
+{
+    assert(!resources_[resource].imported);
+    return resources_[resource].view;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+    uint32_t firstImage, uint32_t imageCount,
+    uint32_t firstBuffer, uint32_t bufferCount)
+{
+    if (imageCount == 0 && bufferCount == 0) {
+        return;
+    }
+    for (uint32_t i = firstImage; i < firstImage + imageCount; ++i) {
+        imageBarriers_[i].image = resources_[imageBarrierResources_[i]].vkImage;
+    }
+    for (uint32_t i = firstBuffer; i < firstBuffer + bufferCount; ++i) {
+        bufferBarriers_[i].buffer = resources_[bufferBarrierResources_[i]].buffer;
+    }
+
+    if (synchronization2_) {
+        VkDependencyInfo dependency = {};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency.pNext = nullptr;
+        dependency.dependencyFlags = 0;
+        dependency.imageMemoryBarrierCount = imageCount;
+        dependency.pImageMemoryBarriers = imageBarriers_.data() + firstImage;
+        dependency.bufferMemoryBarrierCount = bufferCount;
+        dependency.pBufferMemoryBarriers = bufferBarriers_.data() + firstBuffer;
+        vkCmdPipelineBarrier2(commandBuffer, &dependency);
+        return;
+    }
+
+    // one stage mask pair for the whole batch, the legacy bits of the
+    // stages and accesses used here are the same as their 2 variants
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    for (uint32_t i = 0; i < imageCount; ++i) {
+        const VkImageMemoryBarrier2& barrier = imageBarriers_[firstImage + i];
+        VkImageMemoryBarrier& legacy = legacyImageBarriers_[i];
+        legacy = {};
+        legacy.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        legacy.pNext = nullptr;
+        legacy.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+        legacy.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+        legacy.oldLayout = barrier.oldLayout;
+        legacy.newLayout = barrier.newLayout;
+        legacy.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        legacy.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        legacy.image = barrier.image;
+        legacy.subresourceRange = barrier.subresourceRange;
+        srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+        dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+    }
+    for (uint32_t i = 0; i < bufferCount; ++i) {
+        const VkBufferMemoryBarrier2& barrier = bufferBarriers_[firstBuffer + i];
+        VkBufferMemoryBarrier& legacy = legacyBufferBarriers_[i];
+        legacy = {};
+        legacy.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        legacy.pNext = nullptr;
+        legacy.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+        legacy.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+        legacy.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        legacy.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        legacy.buffer = barrier.buffer;
+        legacy.offset = barrier.offset;
+        legacy.size = barrier.size;
+        srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+        dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+    }
+    vkCmdPipelineBarrier(commandBuffer,
+        srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        bufferCount, legacyBufferBarriers_.data(),
+        imageCount, legacyImageBarriers_.data());
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    assert(compiled_);
+    for (Pass& pass : passes_) {
+        if (!pass.live) {
+            continue;
+        }
+        recordBarriers(commandBuffer,
+            pass.firstImageBarrier, pass.imageBarrierCount,
+            pass.firstBufferBarrier, pass.bufferBarrierCount);
+        pass.callback(commandBuffer);
+    }
+    recordBarriers(commandBuffer,
+        finalImageBarrier_, finalImageBarrierCount_,
+        finalBufferBarrier_, finalBufferBarrierCount_);
+}
+
+uint32_t RenderGraph::barrierCount() const
+{
+    return static_cast<uint32_t>(imageBarriers_.size() + bufferBarriers_.size());
+}
+
+std::string RenderGraph::report() const
+{
+    const double MB = 1024.0 * 1024.0;
+    std::string text;
+    char line[256];
+    for (const Pass& pass : passes_) {
+        snprintf(line, sizeof(line), "pass %-20s %s, %u barriers\n",
+            pass.name.c_str(),
+            pass.live ? "live" : "culled",
+            pass.live ? pass.imageBarrierCount + pass.bufferBarrierCount : 0);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "transient memory %.2f MB in %u blocks, %.2f MB without aliasing\n",
+        transientBytes_ / MB,
+        static_cast<uint32_t>(blocks_.size()),
+        unaliasedTransientBytes_ / MB);
+    text += line;
+    return text;
+}
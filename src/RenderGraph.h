@@ -0,0 +1,186 @@
+#ifndef HAMON_RENDER_GRAPH_H__
+#define HAMON_RENDER_GRAPH_H__
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "vulkan.h"
+#include "MemoryStats.h"
+
+class GpuResources;
+
+// How a pass touches a resource, each maps to a stage, access and layout
+enum RenderGraphUsage {
+    RENDER_GRAPH_USAGE_NONE,
+    RENDER_GRAPH_USAGE_TRANSFER_READ,
+    RENDER_GRAPH_USAGE_TRANSFER_WRITE,
+    RENDER_GRAPH_USAGE_COMPUTE_READ,
+    RENDER_GRAPH_USAGE_COMPUTE_WRITE,
+    RENDER_GRAPH_USAGE_INDIRECT_READ,
+    RENDER_GRAPH_USAGE_FRAGMENT_SAMPLED,
+    RENDER_GRAPH_USAGE_COLOR_ATTACHMENT,
+    RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT,
+    RENDER_GRAPH_USAGE_PRESENT,
+    RENDER_GRAPH_USAGE_COUNT
+};
+
+struct TransientImageDesc {
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    uint32_t width;
+    uint32_t height;
+    MemoryCategory category;
+};
+
+// Frame graph built once at init and executed every frame. Passes declare
+// what they read and write, compile() drops passes nothing needs, places
+// transient images whose lifetimes don't overlap in the same memory and
+// precomputes the barriers in front of every pass, so execute() only
+// patches in this frame's handles and records one batch per pass.
+class RenderGraph {
+public:
+    typedef uint32_t ResourceId;
+    typedef uint32_t PassId;
+    typedef std::function<void(VkCommandBuffer)> PassCallback;
+
+    // synchronization2: record vkCmdPipelineBarrier2, vkCmdPipelineBarrier otherwise
+    void init(VkDevice device,
+        GpuResources* resources,
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        bool synchronization2);
+    // destroys the transient images, the device must be idle
+    void shutdown();
+
+    // Resource owned outside the graph, its handle comes from setImage()
+    // every frame. The graph takes it from initialUsage and leaves it in
+    // finalUsage, NONE for either means the state of the previous frame.
+    // Without preserveContents the first access discards the old contents.
+    ResourceId importImage(const char* name,
+        VkImageAspectFlags aspect,
+        RenderGraphUsage initialUsage,
+        RenderGraphUsage finalUsage,
+        bool preserveContents);
+    ResourceId importBuffer(const char* name);
+    // created by compile(), contents don't survive the frame
+    ResourceId createTransientImage(const char* name, const TransientImageDesc& desc);
+
+    PassId addPass(const char* name, PassCallback callback);
+    // in the order the pass accesses them
+    void read(PassId pass, ResourceId resource, RenderGraphUsage usage);
+    void write(PassId pass, ResourceId resource, RenderGraphUsage usage);
+    // the frame's result, passes contributing to it are never culled
+    void markOutput(ResourceId resource);
+
+    void compile();
+
+    void setImage(ResourceId resource, VkImage image);
+    void setBuffer(ResourceId resource, VkBuffer buffer);
+    // transient images only
+    VkImageView imageView(ResourceId resource) const;
+
+    void execute(VkCommandBuffer commandBuffer);
+
+    bool isCulled(PassId pass) const { return !passes_[pass].live; }
+    // barriers recorded per execute()
+    uint32_t barrierCount() const;
+    // device memory of the transient images with and without aliasing
+    VkDeviceSize transientBytes() const { return transientBytes_; }
+    VkDeviceSize unaliasedTransientBytes() const { return unaliasedTransientBytes_; }
+
+    std::string report() const;
+private:
+    struct Access {
+        ResourceId resource;
+        RenderGraphUsage usage;
+    };
+
+    struct Pass {
+        std::string name;
+        PassCallback callback;
+        std::vector<Access> accesses;
+        bool live;
+        // into imageBarriers_ / bufferBarriers_
+        uint32_t firstImageBarrier;
+        uint32_t imageBarrierCount;
+        uint32_t firstBufferBarrier;
+        uint32_t bufferBarrierCount;
+    };
+
+    struct Resource {
+        std::string name;
+        bool image;
+        bool imported;
+        VkImageAspectFlags aspect;
+        RenderGraphUsage initialUsage;
+        RenderGraphUsage finalUsage;
+        bool preserveContents;
+        bool output;
+        TransientImageDesc transient;
+        VkImage vkImage;
+        VkImageView view;
+        VkBuffer buffer;
+        // live passes using it, transient lifetime
+        uint32_t firstPass;
+        uint32_t lastPass;
+        // transient memory block, UINT32_MAX if none
+        uint32_t block;
+        // transient in the same block used before this one, wrapping round
+        ResourceId previousInBlock;
+    };
+
+    // synchronization state of a resource while compiling
+    struct State {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 writeStages;
+        VkAccessFlags2 writeAccess;
+        VkPipelineStageFlags2 readStages;
+        // stages the last write is visible to
+        VkPipelineStageFlags2 visibleStages;
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        uint32_t memoryTypeBits;
+        uint32_t memoryTypeIndex;
+        MemoryCategory category;
+    };
+
+    void addAccess(PassId pass, ResourceId resource, RenderGraphUsage usage);
+    void cullPasses();
+    void allocateTransients();
+    // appends the barrier for one access to imageBarriers_ / bufferBarriers_
+    void buildBarrier(ResourceId resource, RenderGraphUsage usage, State& state, bool record);
+    State initialState(ResourceId resource, const std::vector<State>& endStates) const;
+    // walks the live passes updating states, record appends the barriers
+    void simulate(std::vector<State>& states, bool record);
+    void recordBarriers(VkCommandBuffer commandBuffer,
+        uint32_t firstImage, uint32_t imageCount,
+        uint32_t firstBuffer, uint32_t bufferCount);
+private:
+    VkDevice device_{VK_NULL_HANDLE};
+    GpuResources* gpuResources_ = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+    bool synchronization2_ = false;
+    bool compiled_ = false;
+    std::vector<Pass> passes_;
+    std::vector<Resource> resources_;
+    std::vector<MemoryBlock> blocks_;
+    std::vector<VkImageMemoryBarrier2> imageBarriers_;
+    std::vector<ResourceId> imageBarrierResources_;
+    std::vector<VkBufferMemoryBarrier2> bufferBarriers_;
+    std::vector<ResourceId> bufferBarrierResources_;
+    // final transitions after the last pass
+    uint32_t finalImageBarrier_ = 0;
+    uint32_t finalImageBarrierCount_ = 0;
+    uint32_t finalBufferBarrier_ = 0;
+    uint32_t finalBufferBarrierCount_ = 0;
+    VkDeviceSize transientBytes_ = 0;
+    VkDeviceSize unaliasedTransientBytes_ = 0;
+    // legacy barriers for devices without synchronization2
+    std::vector<VkImageMemoryBarrier> legacyImageBarriers_;
+    std::vector<VkBufferMemoryBarrier> legacyBufferBarriers_;
+};
+
+#endif
@@ -1,125 +1,348 @@
 #include "Renderer.h"
 #include "Vertex.h"
+#include "Trace.h"
+#include "ApiCounters.h"
+#include "StartupTimeline.h"
+#include "ThreadPool.h"
+#include "AllocationCounter.h"
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
-#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <future>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// initial size of the per frame arenas, they grow to the peak if needed
+static const size_t FRAME_ARENA_SIZE = 256 * 1024;
+// frames between device memory budget queries
+static const uint64_t MEMORY_BUDGET_INTERVAL = 120;
+static const float MEMORY_WARNING_FRACTION = 0.9f;
+static const float CAMERA_FOV_Y = glm::radians(45.f);
+static const glm::vec3 CAMERA_POSITION(2.f, 2.f, 2.f);
+// DrawConstants of the mesh shader follow the task shader's cull constants
+static const uint32_t MESH_DRAW_CONSTANTS_OFFSET = 128;
+static_assert(sizeof(MeshletCullConstants) <= MESH_DRAW_CONSTANTS_OFFSET,
+    "cull constants overlap the mesh shader's draw constants");
+// larger static buffers are uploaded in several copies
+static const VkDeviceSize STAGING_BUFFER_SIZE = 1024 * 1024 * 24;
+
+// CPU side texture, decoded off the render thread
+struct TexturePixels {
+    std::vector<uint8_t> data;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+static bool decodeTexture(const char* path, TexturePixels& texture)
+{
+    if (path == nullptr || strcmp(path, "") == 0)
+        return false;
+    HAMON_TRACE_SCOPE("decode texture");
+    int texWidth;
+    int texHeight;
+    int texChannels;
+    stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (pixels == nullptr)
+    {
+        return false;
+    }
+    texture.width = texWidth;
+    texture.height = texHeight;
+    texture.data.assign(pixels, pixels + texWidth * texHeight * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+static void generateCheckerTexture(uint32_t seed, TexturePixels& texture)
+{
+    const uint32_t size = 256;
+    const uint32_t cell = 32;
+    // a different tint per seed so textures are distinguishable
+    uint32_t tint = 0xff000000 | ((seed * 0x9e3779b9u) & 0x00ffffff);
+    texture.width = size;
+    texture.height = size;
+    texture.data.resize(size * size * 4);
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(texture.data.data());
+    for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+            pixels[y * size + x] = ((x / cell + y / cell) & 1) ? tint : 0xffffffff;
+        }
+    }
+}
+
+// on the pool when there is one, inline otherwise
+static std::future<void> runAsync(ThreadPool* threadPool, std::function<void()> task)
+{
+    if (threadPool != nullptr) {
+        return threadPool->submit(std::move(task));
+    }
+    std::packaged_task<void()> packagedTask(std::move(task));
+    packagedTask();
+    return packagedTask.get_future();
+}
+
 Renderer::Renderer(const RendererContext& context)
     : context_(context)
+    , clock_(context.clockMode_, context.fixedTimeStep_)
 {
 
 }
 
 void Renderer::init(const char* vertSpv, const char* fragSpv)
 {
+    HAMON_STARTUP_PHASE("renderer init");
     colorFormat_ = context_.format_;
-    vertShader_ = createShaderModule(context_.device_, vertSpv);
-    fragShader_ = createShaderModule(context_.device_, fragSpv);
-    std::vector<VkDescriptorSetLayoutBinding> bindings(2);
-
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[0].descriptorCount =1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    bindings[0].pImmutableSamplers = nullptr;
+    resources_.init(context_.device_,
+        context_.physicalDevice_,
+        context_.memoryProperties_,
+        context_.capabilities_.memoryBudget);
+    if (context_.meshletRendering_) {
+        // the mesh shader path needs more than the 128 bytes of push
+        // constants every device has
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(context_.physicalDevice_, &properties);
+        bool meshPushConstants = properties.limits.maxPushConstantsSize >=
+            MESH_DRAW_CONSTANTS_OFFSET + sizeof(DrawConstants);
+        geometryPath_ = context_.capabilities_.meshShader && meshPushConstants ?
+            GeometryPath::MeshShader : GeometryPath::MeshletIndirect;
+    }
+    // the transforms come as push constants, the set only holds the texture
+    std::vector<VkDescriptorSetLayoutBinding> bindings(1);
 
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[1].pImmutableSamplers = nullptr;
-    createDepthTexture(context_.extent_.width, context_.extent_.height);
+    bindings[0].binding = 1;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[0].pImmutableSamplers = nullptr;
+    depthFormat_ = selectOptimalDepthFormat(context_.physicalDevice_);
     descriptorSetLayout_ = createDescriptorSetLayout(context_.device_, 
         bindings.data(),
         bindings.size()); 
-    pipelineLayout_ = createPipelineLayout(context_.device_, &descriptorSetLayout_, 1);
+    VkPushConstantRange drawConstantRange = {};
+    drawConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    drawConstantRange.offset = 0;
+    drawConstantRange.size = sizeof(DrawConstants);
+    pipelineLayout_ = createPipelineLayout(context_.device_, &descriptorSetLayout_, 1,
+        &drawConstantRange, 1);
     renderPass_ = createRenderPass(context_.device_, colorFormat_, depthFormat_);
-    graphicPipeline_ = createGraphicsPipeline(context_.device_, 
-        pipelineLayout_, 
-        renderPass_, 
-        vertShader_,
-        fragShader_,
-        context_.extent_.width,
-        context_.extent_.height);
 
-    
-    framebuffers_.resize(context_.imageViews_.size());
-    for (uint32_t i = 0; i < framebuffers_.size(); ++ i) {
-        VkImageView imageView[] = { 
-            context_.imageViews_[i],
-            depthImageView_
-        };
-        framebuffers_[i] = createFrambuffer(context_.device_, renderPass_, 
-            context_.extent_,
-            imageView,
-            ARRAY_SIZE(imageView)
-        );
+    // Shader modules, pipeline compilation and texture decoding only need the
+    // device, they run on the thread pool while this thread creates and
+    // uploads everything that goes through the queue.
+    pipelineCache_.init(context_.device_, context_.threadPool_);
+    pipelineCache_.nameLayout(pipelineLayout_, "scene");
+    pipelineCache_.nameRenderPass(renderPass_, "main");
+    std::future<void> pipelineReady = runAsync(context_.threadPool_, [&, vertSpv, fragSpv] {
+        HAMON_STARTUP_PHASE("graphics pipeline");
+        vertShader_ = createShaderModule(context_.device_, vertSpv);
+        fragShader_ = createShaderModule(context_.device_, fragSpv);
+        pipelineCache_.nameShader(vertShader_, vertSpv);
+        pipelineCache_.nameShader(fragShader_, fragSpv);
+        // permutations used before compile on the workers, the scene
+        // pipeline is waited for (or compiled here if still queued)
+        if (!context_.pipelineKeyFile_.empty()) {
+            pipelineCache_.prewarm(context_.pipelineKeyFile_.c_str());
+        }
+        scenePipelineDesc_.vertexShader = vertShader_;
+        scenePipelineDesc_.fragmentShader = fragShader_;
+        scenePipelineDesc_.layout = pipelineLayout_;
+        scenePipelineDesc_.renderPass = renderPass_;
+        GraphicsPipelineDesc pipelineDesc = scenePipelineDesc_;
+        applyMaterial(MaterialDesc(), pipelineDesc);
+        graphicPipeline_ = pipelineCache_.getGraphics(pipelineDesc);
+    });
+    std::future<void> meshletShadersReady;
+    if (geometryPath_ != GeometryPath::Indexed) {
+        meshletShadersReady = runAsync(context_.threadPool_, [this] {
+            HAMON_STARTUP_PHASE("meshlet shaders");
+            if (geometryPath_ == GeometryPath::MeshShader) {
+                meshletShaders_[0] = createShaderModule(context_.device_, "../task.spv");
+                meshletShaders_[1] = createShaderModule(context_.device_, "../mesh.spv");
+            }
+            else {
+                meshletShaders_[0] = createShaderModule(context_.device_, "../cull.spv");
+            }
+        });
+    }
+
+    const SyntheticSceneDesc& synthetic = context_.syntheticScene_;
+    std::vector<TextureData> textureData(synthetic.drawCount > 0 ? synthetic.textureCount : 1);
+    uint32_t decodeTaskCount = context_.threadPool_ != nullptr ? context_.threadPool_->threadCount() : 1;
+    decodeTaskCount = std::min(decodeTaskCount, static_cast<uint32_t>(textureData.size()));
+    std::vector<std::future<void>> texturesReady;
+    for (uint32_t task = 0; task < decodeTaskCount; ++task) {
+        texturesReady.push_back(runAsync(context_.threadPool_, [&, task, decodeTaskCount] {
+            HAMON_STARTUP_PHASE("decode textures");
+            TexturePixels pixels;
+            for (size_t i = task; i < textureData.size(); i += decodeTaskCount) {
+                if (synthetic.drawCount > 0) {
+                    generateCheckerTexture(static_cast<uint32_t>(i), pixels);
+                }
+                else if (!decodeTexture("../texture.jpg", pixels)) {
+                    generateCheckerTexture(0, pixels);
+                }
+                buildMipChain(pixels.data.data(), pixels.width, pixels.height, textureData[i]);
+            }
+        }));
+    }
+
+    {
+        HAMON_STARTUP_PHASE("framebuffers");
+        setupRenderGraph();
+        framebuffers_.resize(context_.imageViews_.size());
+        for (uint32_t i = 0; i < framebuffers_.size(); ++ i) {
+            VkImageView imageView[] = { 
+                context_.imageViews_[i],
+                renderGraph_.imageView(depthTarget_)
+            };
+            framebuffers_[i] = createFrambuffer(context_.device_, renderPass_, 
+                context_.extent_,
+                imageView,
+                ARRAY_SIZE(imageView)
+            );
+        }
     }
 
     // sync object
-    MAX_FRMAE_IN_FLIGHTS = framebuffers_.size();
-    commandBuffers_.resize(MAX_FRMAE_IN_FLIGHTS);
-    imageAvailableSemaphores_.resize(MAX_FRMAE_IN_FLIGHTS);
-    imageFinishedSemaphores_.resize(MAX_FRMAE_IN_FLIGHTS);
-    inFlights_.resize(MAX_FRMAE_IN_FLIGHTS);
+    framesInFlight_ = std::max(1u, std::min(context_.framesInFlight_, MAX_FRAMES_IN_FLIGHT));
+    commandBuffers_.resize(framesInFlight_);
+    imageAvailableSemaphores_.resize(framesInFlight_);
+    submittedFrames_.assign(framesInFlight_, 0);
+    // frame indices are the timeline values
+    timeline_.init(context_.device_, context_.capabilities_.timelineSemaphore);
+    frameArenas_.resize(framesInFlight_);
+    for (auto& arena : frameArenas_) {
+        arena.reserve(FRAME_ARENA_SIZE);
+    }
+    if (context_.gpuProfiling_) {
+        gpuProfiler_.init(context_.device_,
+            context_.physicalDevice_,
+            context_.graphicsQueueFamilyIndex,
+            framesInFlight_,
+            context_.capabilities_.pipelineStatisticsQuery);
+    }
 
-    for (uint32_t i = 0; i < MAX_FRMAE_IN_FLIGHTS; ++ i) {
+    for (uint32_t i = 0; i < framesInFlight_; ++ i) {
         commandBuffers_[i] = createCommandBuffer(context_.device_, context_.commandPool_);
         imageAvailableSemaphores_[i] = createSemaphore(context_.device_);
-        imageFinishedSemaphores_[i] = createSemaphore(context_.device_);
-        inFlights_[i] = createFence(context_.device_);
-    }
-
-    VkDeviceSize vertexSize = vertices.size() * sizeof(Vertex);
-    VkDeviceSize indexSize = indices.size()  * sizeof(uint16_t);
-    stagingBuffer_ = createBuffer(context_.device_,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 1024 * 1024 * 24);
-    stagingBufferMemory_ = createBufferMemory(
-        context_.device_,
-        stagingBuffer_,
-        context_.memoryProperties_, 
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    vkBindBufferMemory(context_.device_, stagingBuffer_, stagingBufferMemory_, 0);
-    vkMapMemory(context_.device_, stagingBufferMemory_, 0, 1024 * 1024 * 24, 0, &start_ptr);
-    memcpy(start_ptr, vertices.data(), vertexSize);
-    createVertexBuffer(vertexSize);
-    copyBuffer(context_.device_,
-        context_.graphicsQueue_,
-        context_.commandPool_, 
-        vertexBuffer_,
-        stagingBuffer_, 
-        vertexSize);
-
-    createIndexBuffer(indices.size()  *sizeof(uint16_t));
-    memcpy(start_ptr, indices.data(), indexSize);
-    copyBuffer(context_.device_,
-        context_.graphicsQueue_,
-        context_.commandPool_, 
-        indexBuffer_,
-        stagingBuffer_, 
-        indexSize);
-    createUniformBuffers();
+    }
+    imageFinishedSemaphores_.resize(context_.imageViews_.size());
+    for (auto& semaphore : imageFinishedSemaphores_) {
+        semaphore = createSemaphore(context_.device_);
+    }
+
+    {
+        HAMON_STARTUP_PHASE("geometry");
+        if (synthetic.drawCount > 0) {
+            mesh_ = generateGridMesh(synthetic.trianglesPerDraw);
+            drawCount_ = synthetic.drawCount;
+        }
+        else {
+            mesh_ = importMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+        }
+        meshEntity_ = scene_.createEntity();
+        scene_.setMesh(meshEntity_, MeshId(0));
+        scene_.setMaterial(meshEntity_, MaterialId(0));
+        scene_.setLocalBounds(meshEntity_, mesh_.bounds);
+        visibleEntities_.resize(scene_.size());
+        clipMatrices_.resize(scene_.size());
+        VkDeviceSize vertexSize = mesh_.vertices.size() * sizeof(Vertex);
+        VkDeviceSize indexSize = mesh_.indexData.size();
+        stagingBuffer_ = resources_.createBuffer(MEMORY_CATEGORY_STAGING,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            STAGING_BUFFER_SIZE,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        start_ptr = resources_.buffer(stagingBuffer_).mapped;
+        // the mesh shader path fetches vertices as a storage buffer
+        vertexBuffer_ = createStaticBuffer(MEMORY_CATEGORY_VERTEX,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            mesh_.vertices.data(),
+            vertexSize);
+        indexBuffer_ = createStaticBuffer(MEMORY_CATEGORY_INDEX,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            mesh_.indexData.data(),
+            indexSize);
+    }
+    textureSampler_ = createSampler(context_.device_);
+
+    for (auto& ready : texturesReady) {
+        ready.get();
+    }
+    {
+        HAMON_STARTUP_PHASE("upload textures");
+        TextureResidencyDesc residencyDesc;
+        residencyDesc.budget = context_.textureMemoryBudget_;
+        textures_.init(&resources_,
+            &imageStates_,
+            context_.device_,
+            context_.graphicsQueue_,
+            context_.commandPool_,
+            context_.threadPool_,
+            residencyDesc);
+        for (TextureData& data : textureData) {
+            textures_.addTexture(std::move(data));
+        }
+    }
     createDescriptorSets();
-    loadTexture("../texture.jpg");
 
+    pipelineReady.get();
+    materials_.push_back(MaterialDesc());
+    materialPipelines_.push_back(graphicPipeline_);
+    for (uint32_t i = 1; i < synthetic.materialCount; ++i) {
+        // cycles through the features, the repeats share pipelines
+        static const uint32_t SYNTHETIC_FEATURES[] = {
+            MATERIAL_FEATURE_TEXTURE,
+            MATERIAL_FEATURE_TEXTURE | MATERIAL_FEATURE_VERTEX_COLOR,
+            MATERIAL_FEATURE_TEXTURE | MATERIAL_FEATURE_ALPHA_TEST,
+            MATERIAL_FEATURE_VERTEX_COLOR,
+        };
+        MaterialDesc material;
+        material.features = SYNTHETIC_FEATURES[i % ARRAY_SIZE(SYNTHETIC_FEATURES)];
+        material.doubleSided = (i / ARRAY_SIZE(SYNTHETIC_FEATURES)) % 2 == 1;
+        addMaterial(material);
+    }
+    if (geometryPath_ != GeometryPath::Indexed) {
+        meshletShadersReady.get();
+        HAMON_STARTUP_PHASE("meshlet resources");
+        createMeshletResources();
+    }
 }
 
 void Renderer::frameStart()
 {
-    vkWaitForFences(context_.device_, 1, &inFlights_[currentFrame], VK_TRUE, UINT64_MAX);
-    if (inFlights_[currentFrame] != VK_NULL_HANDLE)
     {
-        vkResetFences(context_.device_, 1, &inFlights_[currentFrame]);
+        HAMON_TRACE_SCOPE("wait frame");
+        timeline_.wait(submittedFrames_[currentFrame]);
+    }
+    // may be past the slot's frame when later frames finished too
+    resources_.collect(timeline_.completedValue());
+    frameArenas_[currentFrame].reset();
+    if (frameIndex_ % MEMORY_BUDGET_INTERVAL == 0) {
+        MemoryStats& memoryStats = resources_.memoryStats();
+        memoryStats.updateBudget();
+        bool overBudget = memoryStats.overBudget(MEMORY_WARNING_FRACTION);
+        if (overBudget && !memoryWarning_) {
+            std::cerr << "device memory close to budget\n" << memoryStats.report();
+        }
+        memoryWarning_ = overBudget;
     }
 
-    vkAcquireNextImageKHR(context_.device_,
-        context_.swapchain_,
-        UINT64_MAX, 
-        imageAvailableSemaphores_[currentFrame],
-        VK_NULL_HANDLE,
-        &imageIndex);
+    if (context_.swapchain_ == VK_NULL_HANDLE) {
+        // headless, one target per frame slot so the fence covers it, slots
+        // share targets when there are fewer
+        imageIndex = currentFrame % context_.imageViews_.size();
+    }
+    else {
+        HAMON_TRACE_SCOPE("acquire");
+        vkAcquireNextImageKHR(context_.device_,
+            context_.swapchain_,
+            UINT64_MAX, 
+            imageAvailableSemaphores_[currentFrame],
+            VK_NULL_HANDLE,
+            &imageIndex);
+    }
     VkCommandBuffer commandBuffer = commandBuffers_[currentFrame];
     vkResetCommandBuffer(commandBuffer, 0);
     VkCommandBufferBeginInfo beginInfo ={};
@@ -130,6 +353,29 @@ void Renderer::frameStart()
     
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
+    gpuProfiler_.beginFrame(commandBuffer, currentFrame, frameIndex_);
+    if (context_.gpuReportInterval_ != 0 && frameIndex_ % context_.gpuReportInterval_ == 0) {
+        std::cout << gpuProfiler_.report();
+        if (apiCallCountersInstalled()) {
+            std::cout << apiCallReport();
+        }
+        std::cout << resources_.memoryStats().report();
+        std::cout << textures_.report();
+        std::cout << imageStates_.report();
+        std::cout << renderGraph_.report();
+        std::cout << pipelineCache_.report();
+        if (hostAllocator() != nullptr) {
+            std::cout << hostAllocationReport();
+        }
+        if (allocationTrackingEnabled()) {
+            std::cout << "allocations last frame: " << lastFrameAllocations_ << "\n";
+        }
+    }
+    frameScope_ = gpuProfiler_.beginScope(commandBuffer, "frame");
+}
+
+void Renderer::beginRenderPass(VkCommandBuffer commandBuffer)
+{
     VkClearValue clearValues[2] = {};
     clearValues[0].color = {0,0,0,1};
     clearValues[1].depthStencil = {1.f, 0};
@@ -144,6 +390,7 @@ void Renderer::frameStart()
     passBeginInfo.renderArea.offset = {0,0};
     passBeginInfo.framebuffer = framebuffers_[imageIndex];
     vkCmdBeginRenderPass(commandBuffer, &passBeginInfo,VK_SUBPASS_CONTENTS_INLINE);
+    passScope_ = gpuProfiler_.beginScope(commandBuffer, "main pass", true);
 
       
     VkViewport viewport{};
@@ -164,96 +411,213 @@ void Renderer::frameStart()
 
 void Renderer::render()
 {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    
+    HAMON_TRACE_SCOPE("render");
+    uint64_t allocations = allocationStats().allocations;
     frameStart();
-    VkCommandBuffer commandBuffer = commandBuffers_[currentFrame];
-    VkBuffer uniformBuffer = uniformBuffers_[imageIndex];
-    VkDeviceMemory uniformBufferMemory = uniformBufferMemorys_[imageIndex];
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = uniformBuffers_[imageIndex];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageView = textureImageView_;
-    imageInfo.sampler = textureSampler_;
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    std::vector<VkWriteDescriptorSet> writeDescriptorSet(2);
-    writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSet[0].pNext = nullptr;
-    writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writeDescriptorSet[0].dstBinding = 0;
-    writeDescriptorSet[0].dstArrayElement = 0;
-    writeDescriptorSet[0].pTexelBufferView = nullptr;
-    writeDescriptorSet[0].pImageInfo = nullptr;
-    writeDescriptorSet[0].pBufferInfo = &bufferInfo;
-    writeDescriptorSet[0].descriptorCount = 1;
-    writeDescriptorSet[0].dstSet = descriptorSets_[imageIndex];
-
-    writeDescriptorSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescriptorSet[1].pNext = nullptr;
-    writeDescriptorSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writeDescriptorSet[1].dstBinding = 1;
-    writeDescriptorSet[1].dstArrayElement = 0;
-    writeDescriptorSet[1].pTexelBufferView = nullptr;
-    writeDescriptorSet[1].pImageInfo = &imageInfo;
-    writeDescriptorSet[1].pBufferInfo = nullptr;
-    writeDescriptorSet[1].descriptorCount = 1;
-    writeDescriptorSet[1].dstSet = descriptorSets_[imageIndex];
-    vkUpdateDescriptorSets(context_.device_, writeDescriptorSet.size(), 
-    writeDescriptorSet.data(), 0, nullptr);
-
-    UniformBufferObject ubo;
-    ubo.model = glm::rotate(glm::mat4(1.0), time * glm::radians(90.f), glm::vec3(0,0,1));
-    ubo.view = glm::lookAt(glm::vec3(2.f, 2.f, 2.0f), glm::vec3(0,0,0), glm::vec3(0,0,1));
-    ubo.proj =glm::perspective(glm::radians(45.f), 
+    {
+        HAMON_TRACE_SCOPE("record");
+        recordCommands(commandBuffers_[currentFrame], static_cast<float>(clock_.time()));
+    }
+    frameEnd();
+    clock_.advance();
+    lastFrameAllocations_ = allocationStats().allocations - allocations;
+}
+
+void Renderer::recordCommands(VkCommandBuffer commandBuffer, float time)
+{
+    scene_.setRotation(meshEntity_, glm::angleAxis(time * glm::radians(90.f), glm::vec3(0,0,1)));
+    scene_.updateTransforms(context_.threadPool_);
+
+    glm::mat4 view = glm::lookAt(CAMERA_POSITION, glm::vec3(0,0,0), glm::vec3(0,0,1));
+    glm::mat4 proj =glm::perspective(CAMERA_FOV_Y, 
         context_.extent_.width / (float)context_.extent_.height,
         0.1f, 10.f);
-    ubo.proj[1][1] *= -1;
+    proj[1][1] *= -1;
+    glm::mat4 viewProj = proj * view;
+
+    // one batch for the clip matrices of everything in view, the shaders
+    // need nothing else of the camera
+    glm::vec4 frustumPlanes[6];
+    extractFrustumPlanes(viewProj, frustumPlanes);
+    size_t visibleCount = scene_.cullEntities(frustumPlanes, visibleEntities_.data());
+    scene_.clipMatrices(viewProj, visibleEntities_.data(), visibleCount, clipMatrices_.data());
+    meshVisible_ = false;
+    for (size_t i = 0; i < visibleCount; ++i) {
+        if (visibleEntities_[i] == meshEntity_) {
+            drawConstants_.mvp = clipMatrices_[i];
+            meshVisible_ = true;
+        }
+    }
 
-    void* data;
-    vkMapMemory(context_.device_, uniformBufferMemory, 0, sizeof(UniformBufferObject), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(context_.device_, uniformBufferMemory);
+    // the texture spans the mesh once, so it needs about as many texels as
+    // the mesh's bounding sphere covers pixels
+    const Aabb& bounds = scene_.worldBounds(meshEntity_);
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    float distance = glm::length((bounds.max + bounds.min) * 0.5f - CAMERA_POSITION);
+    float texels = static_cast<float>(context_.extent_.height);
+    if (distance > radius) {
+        texels *= radius / (distance * tanf(CAMERA_FOV_Y * 0.5f));
+    }
+    const uint32_t textureCount = textures_.textureCount();
+    for (uint32_t t = 0; t < std::min(drawCount_, textureCount); ++t) {
+        textures_.requestTexels(t, frameIndex_, texels);
+    }
+    textures_.update(commandBuffer, frameIndex_);
+    refreshTextureDescriptors();
     
-    VkBuffer vertexBuffers[] = {vertexBuffer_};
+    // drawConstants_.mvp is stale while the mesh is out of view
+    if (geometryPath_ != GeometryPath::Indexed && meshVisible_) {
+        cullConstants_ = {};
+        // in model space, the meshlet bounds are
+        extractFrustumPlanes(drawConstants_.mvp, cullConstants_.frustumPlanes);
+        cullConstants_.cameraPosition = glm::inverse(view * scene_.worldMatrix(meshEntity_)) * glm::vec4(0, 0, 0, 1);
+        cullConstants_.meshletCount = static_cast<uint32_t>(meshletData_.meshlets.size());
+    }
+    renderGraph_.setImage(colorTarget_, context_.images_[imageIndex]);
+    renderGraph_.execute(commandBuffer);
+}
+
+void Renderer::drawScene(VkCommandBuffer commandBuffer)
+{
+    beginRenderPass(commandBuffer);
+    const uint32_t textureCount = textures_.textureCount();
+    // every draw is of the mesh entity
+    const uint32_t drawCount = meshVisible_ ? drawCount_ : 0;
+    if (geometryPath_ != GeometryPath::Indexed) {
+        uint32_t drawScope = gpuProfiler_.beginScope(commandBuffer, "meshlets");
+        for (uint32_t draw = 0; draw < drawCount; ++draw) {
+            drawMeshlets(commandBuffer, cullConstants_,
+                descriptorSets_[currentFrame * textureCount + draw % textureCount]);
+        }
+        gpuProfiler_.endScope(commandBuffer, drawScope);
+    }
+    else {
+        VkBuffer vertexBuffers[] = {resources_.buffer(vertexBuffer_).buffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, resources_.buffer(indexBuffer_).buffer, 0, mesh_.indexType);
+
+        const uint32_t materialCount = static_cast<uint32_t>(materialPipelines_.size());
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        uint32_t drawScope = gpuProfiler_.beginScope(commandBuffer, "mesh");
+        for (uint32_t draw = 0; draw < drawCount; ++draw) {
+            // materials still compiling draw with the default one
+            VkPipeline pipeline = pipelineCache_.pipelineOr(materialPipelines_[draw % materialCount],
+                graphicPipeline_);
+            if (pipeline != boundPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                boundPipeline = pipeline;
+            }
+            vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT,
+                0, sizeof(DrawConstants), &drawConstants_);
+            // with a single texture the set stays bound for every draw
+            if (draw == 0 || textureCount > 1) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                    pipelineLayout_, 0, 1, &descriptorSets_[currentFrame * textureCount + draw % textureCount],
+                    0, nullptr);
+            }
+            for (const SubMesh& subMesh : mesh_.subMeshes) {
+                vkCmdDrawIndexed(commandBuffer, 
+                    subMesh.indexCount, 1, subMesh.firstIndex, subMesh.vertexOffset, 0);
+            }
+        }
+        gpuProfiler_.endScope(commandBuffer, drawScope);
+    }
+    gpuProfiler_.endScope(commandBuffer, passScope_);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+void Renderer::cullMeshlets(VkCommandBuffer commandBuffer, const MeshletCullConstants& cullConstants)
+{
+    // barriers against the previous frame's indirect reads and for this
+    // frame's draws come from the render graph
+    uint32_t cullScope = gpuProfiler_.beginScope(commandBuffer, "meshlet cull", true);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resources_.pipeline(meshletPipeline_));
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+        meshletPipelineLayout_, 1, 1, &meshletSet_, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, meshletPipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT,
+        0, sizeof(MeshletCullConstants), &cullConstants);
+    vkCmdDispatch(commandBuffer, (cullConstants.meshletCount + 63) / 64, 1, 1);
+    gpuProfiler_.endScope(commandBuffer, cullScope);
+}
+
+void Renderer::drawMeshlets(VkCommandBuffer commandBuffer,
+    const MeshletCullConstants& cullConstants,
+    VkDescriptorSet descriptorSet)
+{
+    if (geometryPath_ == GeometryPath::MeshShader) {
+        VkDescriptorSet descriptorSets[] = {descriptorSet, meshletSet_};
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources_.pipeline(meshletPipeline_));
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            meshletPipelineLayout_, 0, ARRAY_SIZE(descriptorSets), descriptorSets, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, meshletPipelineLayout_, VK_SHADER_STAGE_TASK_BIT_EXT,
+            0, sizeof(MeshletCullConstants), &cullConstants);
+        vkCmdPushConstants(commandBuffer, meshletPipelineLayout_, VK_SHADER_STAGE_MESH_BIT_EXT,
+            MESH_DRAW_CONSTANTS_OFFSET, sizeof(DrawConstants), &drawConstants_);
+        // one task workgroup culls 32 meshlets
+        vkCmdDrawMeshTasks_(commandBuffer, (cullConstants.meshletCount + 31) / 32, 1, 1);
+        return;
+    }
+
+    VkBuffer vertexBuffers[] = {resources_.buffer(vertexBuffer_).buffer};
     VkDeviceSize offsets[] = {0};
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicPipeline_);
+    VkBuffer drawCommandBuffer = resources_.buffer(drawCommandBuffer_).buffer;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineCache_.pipeline(graphicPipeline_));
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        pipelineLayout_, 0, 1, &descriptorSets_[imageIndex], 0, nullptr);
+        pipelineLayout_, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_VERTEX_BIT,
+        0, sizeof(DrawConstants), &drawConstants_);
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, indexBuffer_, 0, VK_INDEX_TYPE_UINT16);
-
-    vkCmdDrawIndexed(commandBuffer, 
-        static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-    frameEnd();
+    vkCmdBindIndexBuffer(commandBuffer, resources_.buffer(meshletIndexBuffer_).buffer, 0, VK_INDEX_TYPE_UINT32);
+    if (context_.capabilities_.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, 0,
+            cullConstants.meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+        return;
+    }
+    for (uint32_t i = 0; i < cullConstants.meshletCount; ++i) {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer,
+            i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+    }
 }
 
 void Renderer::frameEnd()
 {
     VkCommandBuffer commandBuffer = commandBuffers_[currentFrame];
-    vkCmdEndRenderPass(commandBuffer);
+    gpuProfiler_.endScope(commandBuffer, frameScope_);
     vkEndCommandBuffer(commandBuffer);
 
     //
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSemaphore waitSemaphores[] = {imageAvailableSemaphores_[currentFrame]};
-    VkSemaphore signalSemaphores[] = {imageFinishedSemaphores_[currentFrame]};
+    VkSemaphore signalSemaphores[] = {imageFinishedSemaphores_[imageIndex]};
+    // headless frames neither wait for an image nor get presented
+    const bool present = context_.swapchain_ != VK_NULL_HANDLE;
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
     submitInfo.pNext=  nullptr;
     submitInfo.pCommandBuffers = &commandBuffer;
     submitInfo.commandBufferCount = 1;
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = present ? 1 : 0;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = present ? 1 : 0;
     submitInfo.pSignalSemaphores = signalSemaphores;
-    vkQueueSubmit(context_.graphicsQueue_, 1, &submitInfo,  inFlights_[currentFrame]);
+    {
+        HAMON_TRACE_SCOPE("submit");
+        timeline_.submit(context_.graphicsQueue_, submitInfo, frameIndex_);
+    }
+    if (frameIndex_ == 1) {
+        endStartup();
+    }
+    // present isn't counted, the frame's calls end with its submit
+    if (apiCallCountersInstalled()) {
+        endApiCallFrame();
+    }
+    submittedFrames_[currentFrame] = frameIndex_++;
+    if (!present) {
+        currentFrame = (currentFrame + 1) % framesInFlight_;
+        return;
+    }
 
     VkPresentInfoKHR presentInfo ={};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -264,215 +628,355 @@ void Renderer::frameEnd()
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pWaitSemaphores = signalSemaphores;
-    vkQueuePresentKHR(context_.graphicsQueue_, &presentInfo);
-    currentFrame = (currentFrame + 1) % MAX_FRMAE_IN_FLIGHTS;
+    {
+        HAMON_TRACE_SCOPE("present");
+        vkQueuePresentKHR(context_.graphicsQueue_, &presentInfo);
+    }
+    currentFrame = (currentFrame + 1) % framesInFlight_;
 }
 
 void Renderer::shutdown()
 {
     vkDeviceWaitIdle(context_.device_);
-    vkDestroyBuffer(context_.device_, stagingBuffer_, nullptr);
-    vkFreeMemory(context_.device_, stagingBufferMemory_, nullptr);
-    
-    vkDestroyBuffer(context_.device_, vertexBuffer_, nullptr);
-    vkFreeMemory(context_.device_, vertexBufferMemory_, nullptr);
-
-    vkDestroyBuffer(context_.device_, indexBuffer_, nullptr);
-    vkFreeMemory(context_.device_, indexBufferMemory_, nullptr);
-
-    vkDestroyImage(context_.device_, textureImage_, nullptr);
-    vkDestroyImageView(context_.device_, textureImageView_, nullptr);
-    vkFreeMemory(context_.device_, textureImageMemory_, nullptr);
-
-    vkDestroyImage(context_.device_, depthImage_, nullptr);
-    vkDestroyImageView(context_.device_, depthImageView_, nullptr);
-    vkFreeMemory(context_.device_, depthImageMemory_, nullptr);
-
-    vkDestroySampler(context_.device_, textureSampler_, nullptr);
-    vkDestroyDescriptorSetLayout(context_.device_, descriptorSetLayout_, nullptr);
+    gpuProfiler_.shutdown();
+    textures_.shutdown();
+    renderGraph_.shutdown();
+    vkDestroySampler(context_.device_, textureSampler_, hostAllocator());
+    destroyMeshletResources();
+    vkDestroyDescriptorSetLayout(context_.device_, descriptorSetLayout_, hostAllocator());
 
     vkFreeDescriptorSets(context_.device_, context_.descriptorPool_, descriptorSets_.size(),
         descriptorSets_.data());
     
-    vkDestroyDescriptorPool(context_.device_, context_.descriptorPool_, nullptr);
-    for (auto& uniformBuffer : uniformBuffers_) {
-        vkDestroyBuffer(context_.device_, uniformBuffer, nullptr);
-    }
-    for (auto& uniformBufferMemory : uniformBufferMemorys_) {
-        vkFreeMemory(context_.device_, uniformBufferMemory, nullptr);
+    vkDestroyDescriptorPool(context_.device_, context_.descriptorPool_, hostAllocator());
+    // buffers, images and pipelines that are still alive
+    resources_.destroyAll();
+    if (!context_.pipelineKeyFile_.empty()) {
+        pipelineCache_.saveKeys(context_.pipelineKeyFile_.c_str());
     }
+    pipelineCache_.shutdown();
 
 
-    for (uint32_t i = 0 ; i < MAX_FRMAE_IN_FLIGHTS; ++i) {
-        vkDestroySemaphore(context_.device_, imageAvailableSemaphores_[i], nullptr);
-        vkDestroySemaphore(context_.device_, imageFinishedSemaphores_[i], nullptr);
-        vkDestroyFence(context_.device_, inFlights_[i], nullptr);
+    for (uint32_t i = 0 ; i < framesInFlight_; ++i) {
+        vkDestroySemaphore(context_.device_, imageAvailableSemaphores_[i], hostAllocator());
+    }
+    timeline_.shutdown();
+    for (auto& semaphore : imageFinishedSemaphores_) {
+        vkDestroySemaphore(context_.device_, semaphore, hostAllocator());
     }
     imageAvailableSemaphores_.clear();
     imageFinishedSemaphores_.clear();
-    inFlights_.clear();
 
-    vkDestroyCommandPool(context_.device_, context_.commandPool_, nullptr);
+    vkDestroyCommandPool(context_.device_, context_.commandPool_, hostAllocator());
     for (auto & framebuffer: framebuffers_) {
-        vkDestroyFramebuffer(context_.device_, framebuffer, nullptr);
+        vkDestroyFramebuffer(context_.device_, framebuffer, hostAllocator());
     }
     framebuffers_.clear();
-    vkDestroyShaderModule(context_.device_, vertShader_, nullptr);
-    vkDestroyShaderModule(context_.device_, fragShader_, nullptr);
-    vkDestroyPipelineLayout(context_.device_, pipelineLayout_, nullptr);
-    vkDestroyRenderPass(context_.device_, renderPass_, nullptr);
-    vkDestroyPipeline(context_.device_, graphicPipeline_, nullptr);
-}
-
-void Renderer::createVertexBuffer(size_t vertexSize)
-{
-    vertexBuffer_ = createBuffer(context_.device_, 
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-        vertexSize);
-    vertexBufferMemory_ = createBufferMemory(context_.device_, 
-        vertexBuffer_, 
-        context_.memoryProperties_, 
-        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-    vkBindBufferMemory(context_.device_, vertexBuffer_, vertexBufferMemory_, 0);
+    vkDestroyShaderModule(context_.device_, vertShader_, hostAllocator());
+    vkDestroyShaderModule(context_.device_, fragShader_, hostAllocator());
+    vkDestroyPipelineLayout(context_.device_, pipelineLayout_, hostAllocator());
+    vkDestroyRenderPass(context_.device_, renderPass_, hostAllocator());
 }
 
-void Renderer::createIndexBuffer(size_t indexSize)
+MaterialId Renderer::addMaterial(const MaterialDesc& material)
 {
-    uint32_t indiceSize = sizeof(uint32_t) * indices.size();
-    indexBuffer_ = createBuffer(context_.device_, 
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
-        indexSize);
-    indexBufferMemory_ = createBufferMemory(context_.device_, 
-        indexBuffer_, 
-        context_.memoryProperties_, 
-        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-    
-    vkBindBufferMemory(context_.device_, indexBuffer_, indexBufferMemory_, 0);
-}
-
-void Renderer::createUniformBuffers()
-{
-    uint32_t uniformSize = sizeof(UniformBufferObject);
-    uniformBufferMemorys_.resize(framebuffers_.size());
-    uniformBuffers_.resize(framebuffers_.size());
-    for (uint32_t i = 0; i < framebuffers_.size(); ++i) 
-    {
-        uniformBuffers_[i] = createBuffer(context_.device_, 
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-            uniformSize);
-        uniformBufferMemorys_[i] = createBufferMemory(context_.device_, 
-            uniformBuffers_[i], 
-            context_.memoryProperties_, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    
-        vkBindBufferMemory(context_.device_, uniformBuffers_[i], uniformBufferMemorys_[i], 0);
-    }
+    GraphicsPipelineDesc pipelineDesc = scenePipelineDesc_;
+    applyMaterial(material, pipelineDesc);
+    MaterialId id(static_cast<uint32_t>(materials_.size()));
+    materials_.push_back(material);
+    materialPipelines_.push_back(pipelineCache_.requestGraphics(pipelineDesc));
+    return id;
 }
 
 void Renderer::createDescriptorSets()
 {
-    descriptorSets_.resize(context_.imageViews_.size());
-    for (uint32_t i = 0; i < context_.imageViews_.size(); ++i)
+    // every (frame slot, texture) pair gets its own set, the texture changes
+    // when its resident mips do
+    uint32_t textureCount = textures_.textureCount();
+    descriptorSets_.resize(framesInFlight_ * textureCount);
+    descriptorVersions_.resize(descriptorSets_.size());
+    for (uint32_t i = 0; i < descriptorSets_.size(); ++i)
     {
         descriptorSets_[i] = createDescriptorSet(context_.device_,
             context_.descriptorPool_,
             &descriptorSetLayout_,
             1);
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageView = resources_.image(textures_.image(i % textureCount)).view;
+        descriptorVersions_[i] = textures_.version(i % textureCount);
+        imageInfo.sampler = textureSampler_;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet writeDescriptorSet[1] = {};
+        writeDescriptorSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[0].pNext = nullptr;
+        writeDescriptorSet[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writeDescriptorSet[0].dstBinding = 1;
+        writeDescriptorSet[0].dstArrayElement = 0;
+        writeDescriptorSet[0].pTexelBufferView = nullptr;
+        writeDescriptorSet[0].pImageInfo = &imageInfo;
+        writeDescriptorSet[0].pBufferInfo = nullptr;
+        writeDescriptorSet[0].descriptorCount = 1;
+        writeDescriptorSet[0].dstSet = descriptorSets_[i];
+        vkUpdateDescriptorSets(context_.device_, ARRAY_SIZE(writeDescriptorSet),
+            writeDescriptorSet, 0, nullptr);
     }
 }
 
-void Renderer::loadTexture(const char* path)
+void Renderer::refreshTextureDescriptors()
 {
-    if (path == nullptr || strcmp(path, "") == 0)
-        return;
-    int texWidth;
-    int texHeight;
-    int texChannels;
-    stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    if (pixels == nullptr)
-    {
-        return;
+    const uint32_t textureCount = textures_.textureCount();
+    LinearArena& arena = frameArena();
+    VkWriteDescriptorSet* writes = arena.allocate<VkWriteDescriptorSet>(textureCount);
+    VkDescriptorImageInfo* imageInfos = arena.allocate<VkDescriptorImageInfo>(textureCount);
+    uint32_t writeCount = 0;
+    for (uint32_t t = 0; t < textureCount; ++t) {
+        uint32_t set = currentFrame * textureCount + t;
+        if (descriptorVersions_[set] == textures_.version(t)) {
+            continue;
+        }
+        descriptorVersions_[set] = textures_.version(t);
+
+        VkDescriptorImageInfo& imageInfo = imageInfos[writeCount];
+        imageInfo.imageView = resources_.image(textures_.image(t)).view;
+        imageInfo.sampler = textureSampler_;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet& write = writes[writeCount++];
+        write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.dstBinding = 1;
+        write.dstArrayElement = 0;
+        write.pImageInfo = &imageInfo;
+        write.descriptorCount = 1;
+        write.dstSet = descriptorSets_[set];
     }
-    textureImage_ = createImage2D(context_.device_, 
-        VK_FORMAT_R8G8B8A8_UNORM, 
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-        texWidth,
-        texHeight,
-        1,
-        1);
-    textureImageMemory_ = createImageMemory(context_.device_,
-        textureImage_,
+    if (writeCount > 0) {
+        vkUpdateDescriptorSets(context_.device_, writeCount, writes, 0, nullptr);
+    }
+}
+
+void Renderer::setupRenderGraph()
+{
+    renderGraph_.init(context_.device_,
+        &resources_,
         context_.memoryProperties_,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkBindImageMemory(context_.device_,
-        textureImage_,
-        textureImageMemory_,
-        0);
-    memcpy(start_ptr, pixels, texWidth * texHeight * 4);
-    
-    stbi_image_free(pixels);
-    pixels = nullptr;
-
-
-    // 将纹理layout 转换成 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-    // 以便GPU传输
-    transitionImageLayout(context_.device_,
-        context_.graphicsQueue_, 
-        context_.commandPool_,
-        textureImage_,
-        VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(context_.device_,
-        context_.graphicsQueue_, 
-        context_.commandPool_,
-        textureImage_,
-        stagingBuffer_,
-        texWidth,
-        texHeight);
-    // 
-    transitionImageLayout(context_.device_,
-        context_.graphicsQueue_, 
-        context_.commandPool_,
-        textureImage_,
-        VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    textureImageView_ = createImageView2D(context_.device_,
-        textureImage_,
+        context_.capabilities_.synchronization2);
+    // cleared every frame, nothing to keep from the last one
+    const bool present = context_.swapchain_ != VK_NULL_HANDLE;
+    RenderGraphUsage colorUsage = present ? RENDER_GRAPH_USAGE_PRESENT : RENDER_GRAPH_USAGE_NONE;
+    colorTarget_ = renderGraph_.importImage("color",
         VK_IMAGE_ASPECT_COLOR_BIT,
-        VK_FORMAT_R8G8B8A8_UNORM);
-    textureSampler_ = createSampler(context_.device_);
+        colorUsage,
+        colorUsage,
+        false);
+    TransientImageDesc depthDesc = {};
+    depthDesc.format = depthFormat_;
+    depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    depthDesc.width = context_.extent_.width;
+    depthDesc.height = context_.extent_.height;
+    depthDesc.category = MEMORY_CATEGORY_DEPTH;
+    depthTarget_ = renderGraph_.createTransientImage("depth", depthDesc);
+
+    if (geometryPath_ == GeometryPath::MeshletIndirect) {
+        // the buffer is created with the meshlet resources
+        drawCommands_ = renderGraph_.importBuffer("draw commands");
+        RenderGraph::PassId cullPass = renderGraph_.addPass("meshlet cull", [this](VkCommandBuffer commandBuffer) {
+            // nothing draws the commands then
+            if (!meshVisible_) {
+                return;
+            }
+            cullMeshlets(commandBuffer, cullConstants_);
+        });
+        renderGraph_.write(cullPass, drawCommands_, RENDER_GRAPH_USAGE_COMPUTE_WRITE);
+    }
+    RenderGraph::PassId mainPass = renderGraph_.addPass("main pass", [this](VkCommandBuffer commandBuffer) {
+        drawScene(commandBuffer);
+    });
+    if (geometryPath_ == GeometryPath::MeshletIndirect) {
+        renderGraph_.read(mainPass, drawCommands_, RENDER_GRAPH_USAGE_INDIRECT_READ);
+    }
+    renderGraph_.write(mainPass, colorTarget_, RENDER_GRAPH_USAGE_COLOR_ATTACHMENT);
+    renderGraph_.write(mainPass, depthTarget_, RENDER_GRAPH_USAGE_DEPTH_ATTACHMENT);
+    renderGraph_.markOutput(colorTarget_);
+    renderGraph_.compile();
 }
 
-void Renderer::createDepthTexture(uint32_t width, uint32_t height)
+BufferHandle Renderer::createStaticBuffer(MemoryCategory category,
+    VkBufferUsageFlags usage,
+    const void* data,
+    VkDeviceSize size)
 {
-    depthFormat_ = selectOptimalDepthFormat(context_.physicalDevice_);
+    HAMON_TRACE_SCOPE("upload buffer");
+    BufferHandle buffer = resources_.createBuffer(category,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+        size,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // copyBuffer() waits for the device, the staging memory is free again
+    // after every chunk
+    for (VkDeviceSize offset = 0; offset < size; offset += STAGING_BUFFER_SIZE) {
+        VkDeviceSize chunk = std::min(size - offset, STAGING_BUFFER_SIZE);
+        memcpy(start_ptr, static_cast<const uint8_t*>(data) + offset, chunk);
+        copyBuffer(context_.device_,
+            context_.graphicsQueue_,
+            context_.commandPool_,
+            resources_.buffer(buffer).buffer,
+            resources_.buffer(stagingBuffer_).buffer,
+            chunk,
+            offset);
+    }
+    return buffer;
+}
 
-    depthImage_ = createImage2D(context_.device_, 
-        depthFormat_, 
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-        width,
-        height,
-        1,
+void Renderer::createMeshletResources()
+{
+    std::vector<uint32_t> meshIndices = mesh_.unpackIndices();
+    buildMeshlets(meshletData_,
+        meshIndices.data(),
+        meshIndices.size(),
+        &mesh_.vertices[0].position.x,
+        mesh_.vertices.size(),
+        sizeof(Vertex));
+    const uint32_t meshletCount = static_cast<uint32_t>(meshletData_.meshlets.size());
+
+    meshletBuffer_ = createStaticBuffer(MEMORY_CATEGORY_STORAGE,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        meshletData_.meshlets.data(),
+        meshletCount * sizeof(Meshlet));
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    auto addBinding = [&](uint32_t binding, VkShaderStageFlags stages, BufferHandle buffer) {
+        VkDescriptorSetLayoutBinding layoutBinding = {};
+        layoutBinding.binding = binding;
+        layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBinding.descriptorCount = 1;
+        layoutBinding.stageFlags = stages;
+        layoutBinding.pImmutableSamplers = nullptr;
+        bindings.push_back(layoutBinding);
+        bufferInfos.push_back({resources_.buffer(buffer).buffer, 0, VK_WHOLE_SIZE});
+    };
+
+    VkPushConstantRange pushConstantRanges[2] = {};
+    pushConstantRanges[0].offset = 0;
+    pushConstantRanges[0].size = sizeof(MeshletCullConstants);
+    uint32_t pushConstantRangeCount = 1;
+    if (geometryPath_ == GeometryPath::MeshShader) {
+        // the mesh shader reads the triangle stream as uints
+        std::vector<uint8_t> triangles = meshletData_.triangles;
+        triangles.resize((triangles.size() + 3) & ~size_t(3));
+        meshletVertexBuffer_ = createStaticBuffer(MEMORY_CATEGORY_STORAGE,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            meshletData_.vertices.data(),
+            meshletData_.vertices.size() * sizeof(uint32_t));
+        meshletTriangleBuffer_ = createStaticBuffer(MEMORY_CATEGORY_STORAGE,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            triangles.data(),
+            triangles.size());
+
+        addBinding(0, VK_SHADER_STAGE_MESH_BIT_EXT, vertexBuffer_);
+        addBinding(1, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, meshletBuffer_);
+        addBinding(2, VK_SHADER_STAGE_MESH_BIT_EXT, meshletVertexBuffer_);
+        addBinding(3, VK_SHADER_STAGE_MESH_BIT_EXT, meshletTriangleBuffer_);
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT;
+        pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_MESH_BIT_EXT;
+        pushConstantRanges[1].offset = MESH_DRAW_CONSTANTS_OFFSET;
+        pushConstantRanges[1].size = sizeof(DrawConstants);
+        pushConstantRangeCount = 2;
+    }
+    else {
+        std::vector<uint32_t> meshletIndices = buildMeshletIndices(meshletData_);
+        meshletIndexBuffer_ = createStaticBuffer(MEMORY_CATEGORY_INDEX,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            meshletIndices.data(),
+            meshletIndices.size() * sizeof(uint32_t));
+        drawCommandBuffer_ = resources_.createBuffer(MEMORY_CATEGORY_STORAGE,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            meshletCount * sizeof(VkDrawIndexedIndirectCommand),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        renderGraph_.setBuffer(drawCommands_, resources_.buffer(drawCommandBuffer_).buffer);
+
+        addBinding(1, VK_SHADER_STAGE_COMPUTE_BIT, meshletBuffer_);
+        addBinding(4, VK_SHADER_STAGE_COMPUTE_BIT, drawCommandBuffer_);
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    meshletSetLayout_ = createDescriptorSetLayout(context_.device_,
+        bindings.data(),
+        bindings.size());
+    VkDescriptorSetLayout setLayouts[] = {descriptorSetLayout_, meshletSetLayout_};
+    meshletPipelineLayout_ = createPipelineLayout(context_.device_,
+        setLayouts,
+        ARRAY_SIZE(setLayouts),
+        pushConstantRanges,
+        pushConstantRangeCount);
+    meshletSet_ = createDescriptorSet(context_.device_,
+        context_.descriptorPool_,
+        &meshletSetLayout_,
         1);
-    depthImageMemory_ = createImageMemory(context_.device_,
-        depthImage_,
-        context_.memoryProperties_,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkBindImageMemory(context_.device_,
-        depthImage_,
-        depthImageMemory_,
-        0);
-    depthImageView_ = createImageView2D(context_.device_, depthImage_, 
-        VK_IMAGE_ASPECT_DEPTH_BIT, 
-        depthFormat_);
-    transitionImageLayout(context_.device_,
-        context_.graphicsQueue_, context_.commandPool_,
-        depthImage_,
-        depthFormat_,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL    
-    );
-}
\ No newline at end of file
+
+    std::vector<VkWriteDescriptorSet> writeDescriptorSet(bindings.size());
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        writeDescriptorSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSet[i].pNext = nullptr;
+        writeDescriptorSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSet[i].dstBinding = bindings[i].binding;
+        writeDescriptorSet[i].dstArrayElement = 0;
+        writeDescriptorSet[i].pTexelBufferView = nullptr;
+        writeDescriptorSet[i].pImageInfo = nullptr;
+        writeDescriptorSet[i].pBufferInfo = &bufferInfos[i];
+        writeDescriptorSet[i].descriptorCount = 1;
+        writeDescriptorSet[i].dstSet = meshletSet_;
+    }
+    vkUpdateDescriptorSets(context_.device_, writeDescriptorSet.size(),
+        writeDescriptorSet.data(), 0, nullptr);
+
+    // shader modules are created by init() on the thread pool
+    if (geometryPath_ == GeometryPath::MeshShader) {
+        meshletPipeline_ = resources_.addPipeline(createMeshShaderPipeline(context_.device_,
+            meshletPipelineLayout_,
+            renderPass_,
+            meshletShaders_[0],
+            meshletShaders_[1],
+            fragShader_));
+        vkCmdDrawMeshTasks_ = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(
+            vkGetDeviceProcAddr(context_.device_, "vkCmdDrawMeshTasksEXT"));
+    }
+    else {
+        meshletPipeline_ = resources_.addPipeline(createComputePipeline(context_.device_,
+            meshletPipelineLayout_,
+            meshletShaders_[0]));
+    }
+}
+
+void Renderer::destroyMeshletResources()
+{
+    if (meshletSet_ != VK_NULL_HANDLE) {
+        vkFreeDescriptorSets(context_.device_, context_.descriptorPool_, 1, &meshletSet_);
+        meshletSet_ = VK_NULL_HANDLE;
+    }
+    resources_.destroy(meshletPipeline_);
+    vkDestroyPipelineLayout(context_.device_, meshletPipelineLayout_, hostAllocator());
+    vkDestroyDescriptorSetLayout(context_.device_, meshletSetLayout_, hostAllocator());
+    for (auto& shader : meshletShaders_) {
+        vkDestroyShaderModule(context_.device_, shader, hostAllocator());
+        shader = VK_NULL_HANDLE;
+    }
+
+    BufferHandle buffers[] = {
+        meshletBuffer_,
+        meshletVertexBuffer_,
+        meshletTriangleBuffer_,
+        meshletIndexBuffer_,
+        drawCommandBuffer_,
+    };
+    for (uint32_t i = 0; i < ARRAY_SIZE(buffers); ++i) {
+        resources_.destroy(buffers[i]);
+    }
+    meshletPipelineLayout_ = VK_NULL_HANDLE;
+    meshletSetLayout_ = VK_NULL_HANDLE;
+}
@@ -1,5 +1,33 @@
 #pragma once
 #include "VulkanUtils.h"
+#include "VulkanExt.h"
+#include "Meshlet.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "GpuResources.h"
+#include "GpuProfiler.h"
+#include "SimulationClock.h"
+#include "LinearArena.h"
+#include "TextureResidency.h"
+#include "ImageStateTracker.h"
+#include "GpuTimeline.h"
+#include "RenderGraph.h"
+#include "PipelineCache.h"
+#include "Material.h"
+
+class ThreadPool;
+
+// upper bound of RendererContext::framesInFlight_
+static const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// Generated content for benchmarks, drawCount 0 renders the demo mesh
+struct SyntheticSceneDesc {
+    uint32_t drawCount = 0;
+    uint32_t trianglesPerDraw = 2;
+    uint32_t textureCount = 1;
+    // shader permutations the draws cycle through
+    uint32_t materialCount = 1;
+};
 
 struct RendererContext {
     VkExtent2D extent_;
@@ -10,9 +38,41 @@ struct RendererContext {
     VkCommandPool commandPool_;
     VkDescriptorPool descriptorPool_;
     VkDevice device_{VK_NULL_HANDLE};
+    // VK_NULL_HANDLE renders headless into imageViews_, no acquire / present
     VkSwapchainKHR  swapchain_;
+    // frames the CPU may record ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT.
+    // Independent of the image count, fewer is less latency, more keeps the
+    // GPU fed when CPU frame times vary.
+    uint32_t framesInFlight_ = 2;
     VkPhysicalDeviceMemoryProperties memoryProperties_;
     std::vector<VkImageView>   imageViews_;
+    // the images of imageViews_, for the render graph's barriers
+    std::vector<VkImage> images_;
+    DeviceCapabilities capabilities_;
+    // optional, used to spread per frame CPU work
+    ThreadPool* threadPool_ = nullptr;
+    // draw through meshlets (mesh shaders or compute + indirect) instead of
+    // one indexed draw
+    bool meshletRendering_ = false;
+    // timestamp / pipeline statistics queries around passes
+    bool gpuProfiling_ = true;
+    // print the GPU profiler results every N frames, 0 disables
+    uint32_t gpuReportInterval_ = 0;
+    SyntheticSceneDesc syntheticScene_;
+    // FixedStep makes every run render the same frames
+    ClockMode clockMode_ = ClockMode::RealTime;
+    double fixedTimeStep_ = 1.0 / 60.0;
+    // device memory for textures, 0 keeps every mip of used textures resident
+    VkDeviceSize textureMemoryBudget_ = 0;
+    // pipeline keys of earlier runs, compiled in the background at startup
+    // and rewritten at shutdown, empty disables
+    std::string pipelineKeyFile_;
+};
+
+enum class GeometryPath {
+    Indexed,
+    MeshShader,      // task shader culls, mesh shader emits triangles
+    MeshletIndirect, // compute shader culls into indexed indirect draws
 };
 
 struct FrameData {
@@ -35,59 +95,148 @@ public:
     void frameEnd();
 
     void shutdown();
+
+    // Frees the resource once the frame being recorded has finished on the
+    // GPU, safe to call at any time without idling the device.
+    void release(BufferHandle handle) { resources_.release(handle, frameIndex_); }
+    void release(ImageHandle handle) { resources_.release(handle, frameIndex_); }
+    void release(PipelineHandle handle) { resources_.release(handle, frameIndex_); }
+
+    // Transient CPU memory for the frame being recorded, it stays valid
+    // until the same frame slot comes round again
+    LinearArena& frameArena() { return frameArenas_[currentFrame]; }
+    // operator new calls during the last render(), 0 without allocation tracking
+    uint64_t lastFrameAllocations() const { return lastFrameAllocations_; }
+    // every frame index <= this has finished on the GPU, one counter read
+    uint64_t completedFrame() { return timeline_.completedValue(); }
+
+    const GpuProfiler& gpuProfiler() const { return gpuProfiler_; }
+    const MemoryStats& memoryStats() const { return resources_.memoryStats(); }
+    const TextureResidency& textureResidency() const { return textures_; }
+    const PipelineCache& pipelineCache() const { return pipelineCache_; }
+
+    // After init(). The permutation compiles in the background, draws use the
+    // default material (MaterialId(0)) until it is ready.
+    MaterialId addMaterial(const MaterialDesc& material);
+    uint32_t materialCount() const { return static_cast<uint32_t>(materials_.size()); }
+    const SimulationClock& clock() const { return clock_; }
 private:
-    void createVertexBuffer(size_t vertexSize);
-    void createIndexBuffer(size_t indexSize);
-    void createUniformBuffers();
     void createDescriptorSets();
-    void loadTexture(const char* path);
-    void createDepthTexture(uint32_t width, uint32_t height);
+    // rewrites the texture of the frame slot's sets whose image was swapped
+    // by the residency update
+    void refreshTextureDescriptors();
+    // passes and attachments of a frame, depthFormat_ must be selected
+    void setupRenderGraph();
+    // device local buffer filled through the staging buffer
+    BufferHandle createStaticBuffer(MemoryCategory category,
+        VkBufferUsageFlags usage,
+        const void* data,
+        VkDeviceSize size);
+    void createMeshletResources();
+    void destroyMeshletResources();
+    void recordCommands(VkCommandBuffer commandBuffer, float time);
+    // main pass of the render graph
+    void drawScene(VkCommandBuffer commandBuffer);
+    void beginRenderPass(VkCommandBuffer commandBuffer);
+    void cullMeshlets(VkCommandBuffer commandBuffer, const MeshletCullConstants& cullConstants);
+    void drawMeshlets(VkCommandBuffer commandBuffer,
+        const MeshletCullConstants& cullConstants,
+        VkDescriptorSet descriptorSet);
 private:
     RendererContext context_;
-    VkBuffer vertexBuffer_{VK_NULL_HANDLE};
-    VkDeviceMemory vertexBufferMemory_{VK_NULL_HANDLE};
-    VkBuffer indexBuffer_{VK_NULL_HANDLE};
-    VkDeviceMemory indexBufferMemory_{VK_NULL_HANDLE};
+    Scene scene_;
+    SimulationClock clock_;
+    EntityId meshEntity_;
+    Mesh mesh_;
+    uint32_t drawCount_ = 1;
+    GpuResources resources_;
+    BufferHandle vertexBuffer_;
+    BufferHandle indexBuffer_;
     uint32_t imageIndex = 0;
     uint32_t currentFrame= 0;
+    // monotonic index of the frame being recorded, starts at 1
+    uint64_t frameIndex_ = 1;
+    // frameIndex_ last submitted from frame slot i, 0 if none
+    std::vector<uint64_t> submittedFrames_;
+    std::vector<LinearArena> frameArenas_;
+    uint64_t lastFrameAllocations_ = 0;
+    // a heap went past MEMORY_WARNING_FRACTION of its budget, warned once
+    bool memoryWarning_ = false;
+    GpuProfiler gpuProfiler_;
+    uint32_t frameScope_ = GPU_PROFILER_INVALID_SCOPE;
+    uint32_t passScope_ = GPU_PROFILER_INVALID_SCOPE;
     VkPipelineLayout pipelineLayout_{VK_NULL_HANDLE};
     VkRenderPass renderPass_;
-    VkPipeline graphicPipeline_;
+    PipelineCache pipelineCache_;
+    // the default material's, fallback of the others
+    PipelineCache::PipelineId graphicPipeline_ = 0;
+    // state shared by every material permutation
+    GraphicsPipelineDesc scenePipelineDesc_;
+    // indexed by MaterialId
+    std::vector<MaterialDesc> materials_;
+    std::vector<PipelineCache::PipelineId> materialPipelines_;
     VkShaderModule vertShader_;
     VkShaderModule fragShader_;
-    int MAX_FRMAE_IN_FLIGHTS = 2;
+    uint32_t framesInFlight_ = 2;
 
+    // per swapchain image
     std::vector<VkFramebuffer> framebuffers_;
-    // sync object
+    // waited by the present of the image, which no fence covers
+    std::vector<VkSemaphore> imageFinishedSemaphores_;
+
+    // per frame slot, indexed by currentFrame
     std::vector<VkCommandBuffer> commandBuffers_;
     std::vector<VkSemaphore> imageAvailableSemaphores_;
-    std::vector<VkSemaphore> imageFinishedSemaphores_;
-    std::vector<VkFence> inFlights_;
+    // signals frameIndex_ with every frame's submit
+    GpuTimeline timeline_;
 
     // DescriptorSet
     VkDescriptorSetLayout descriptorSetLayout_;
 
-    // Uniform Buffers
-    std::vector<VkBuffer> uniformBuffers_;
-    std::vector<VkDeviceMemory> uniformBufferMemorys_;
+    // [currentFrame * textureCount + texture]
     std::vector<VkDescriptorSet> descriptorSets_;
+    // texture version each set was last written with
+    std::vector<uint32_t> descriptorVersions_;
 
     // Images
-    VkImage textureImage_{VK_NULL_HANDLE};
-    VkDeviceMemory textureImageMemory_{VK_NULL_HANDLE};
-
-    VkImageView textureImageView_{VK_NULL_HANDLE};
+    // layouts of the images recorded into outside the render graph
+    ImageStateTracker imageStates_;
+    TextureResidency textures_;
     VkSampler textureSampler_{VK_NULL_HANDLE};
     VkFormat colorFormat_;
-    // Depth Image
     VkFormat depthFormat_;
-    VkImage depthImage_{VK_NULL_HANDLE};
-    VkDeviceMemory depthImageMemory_{VK_NULL_HANDLE};
 
-    VkImageView depthImageView_{VK_NULL_HANDLE};
+    RenderGraph renderGraph_;
+    RenderGraph::ResourceId colorTarget_ = 0;
+    // transient
+    RenderGraph::ResourceId depthTarget_ = 0;
+    // meshlet indirect path only
+    RenderGraph::ResourceId drawCommands_ = 0;
+    // written by recordCommands for the passes
+    MeshletCullConstants cullConstants_ = {};
+    DrawConstants drawConstants_ = {};
+    bool meshVisible_ = false;
+    // sized to the scene, filled every frame
+    std::vector<EntityId> visibleEntities_;
+    std::vector<glm::mat4> clipMatrices_;
+
+    // Meshlets
+    GeometryPath geometryPath_ = GeometryPath::Indexed;
+    MeshletData meshletData_;
+    VkDescriptorSetLayout meshletSetLayout_{VK_NULL_HANDLE};
+    VkDescriptorSet meshletSet_{VK_NULL_HANDLE};
+    VkPipelineLayout meshletPipelineLayout_{VK_NULL_HANDLE};
+    PipelineHandle meshletPipeline_;
+    VkShaderModule meshletShaders_[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasks_{nullptr};
+    BufferHandle meshletBuffer_;
+    BufferHandle meshletVertexBuffer_;
+    BufferHandle meshletTriangleBuffer_;
+    // fallback path only
+    BufferHandle meshletIndexBuffer_;
+    BufferHandle drawCommandBuffer_;
 
     // Upload Buffer
-    VkBuffer stagingBuffer_{VK_NULL_HANDLE}; 
-    VkDeviceMemory stagingBufferMemory_{VK_NULL_HANDLE};
+    BufferHandle stagingBuffer_;
     void* start_ptr; // 开始地址
 };
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "SimdMath.h"
+
+// below this many entities per level the threads cost more than they save
+static const size_t PARALLEL_UPDATE_THRESHOLD = 1024;
+static const size_t PARALLEL_UPDATE_BATCH = 256;
+
+Aabb transformAabb(const glm::mat4& matrix, const Aabb& aabb)
+{
+    glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extent = (aabb.max - aabb.min) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(matrix * glm::vec4(center, 1.f));
+    glm::vec3 worldExtent = glm::abs(glm::vec3(matrix[0])) * extent.x +
+        glm::abs(glm::vec3(matrix[1])) * extent.y +
+        glm::abs(glm::vec3(matrix[2])) * extent.z;
+    Aabb result;
+    result.min = worldCenter - worldExtent;
+    result.max = worldCenter + worldExtent;
+    return result;
+}
+
+bool aabbInFrustum(const glm::vec4 planes[6], const Aabb& aabb)
+{
+    for (int i = 0; i < 6; ++i) {
+        // the corner furthest along the plane normal
+        glm::vec3 corner(planes[i].x >= 0.f ? aabb.max.x : aabb.min.x,
+            planes[i].y >= 0.f ? aabb.max.y : aabb.min.y,
+            planes[i].z >= 0.f ? aabb.max.z : aabb.min.z);
+        if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+EntityId Scene::createEntity(EntityId parent)
+{
+    EntityId entity(static_cast<uint32_t>(parents_.size()));
+    assert(!parent || size_t(parent) < size_t(entity));
+
+    Aabb emptyBounds;
+    emptyBounds.min = glm::vec3(0.f);
+    emptyBounds.max = glm::vec3(0.f);
+
+    parents_.push_back(parent);
+    depths_.push_back(parent ? depths_[parent] + 1 : 0);
+    translations_.push_back(glm::vec3(0.f));
+    rotations_.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+    scales_.push_back(glm::vec3(1.f));
+    localBounds_.push_back(emptyBounds);
+    worldMatrices_.push_back(glm::mat4(1.f));
+    worldBounds_.push_back(emptyBounds);
+    meshes_.push_back(MeshId::INVALID());
+    materials_.push_back(MaterialId::INVALID());
+    dirty_.push_back(1);
+    anyDirty_ = true;
+    return entity;
+}
+
+void Scene::setTranslation(EntityId entity, const glm::vec3& translation)
+{
+    translations_[entity] = translation;
+    markDirty(entity);
+}
+
+void Scene::setRotation(EntityId entity, const glm::quat& rotation)
+{
+    rotations_[entity] = rotation;
+    markDirty(entity);
+}
+
+void Scene::setScale(EntityId entity, const glm::vec3& scale)
+{
+    scales_[entity] = scale;
+    markDirty(entity);
+}
+
+void Scene::setLocalBounds(EntityId entity, const Aabb& bounds)
+{
+    localBounds_[entity] = bounds;
+    markDirty(entity);
+}
+
+void Scene::markDirty(EntityId entity)
+{
+    dirty_[entity] = 1;
+    anyDirty_ = true;
+}
+
+void Scene::updateEntity(EntityId entity)
+{
+    // translate * rotate * scale without the full matrix products
+    glm::mat4 local = glm::mat4_cast(rotations_[entity]);
+    const glm::vec3& scale = scales_[entity];
+    local[0] *= scale.x;
+    local[1] *= scale.y;
+    local[2] *= scale.z;
+    local[3] = glm::vec4(translations_[entity], 1.f);
+
+    EntityId parent = parents_[entity];
+    worldMatrices_[entity] = parent ? worldMatrices_[parent] * local : local;
+    worldBounds_[entity] = transformAabb(worldMatrices_[entity], localBounds_[entity]);
+}
+
+size_t Scene::cullEntities(const glm::vec4 frustumPlanes[6], EntityId* visible) const
+{
+    size_t count = 0;
+    for (uint32_t i = 0; i < parents_.size(); ++i) {
+        EntityId entity(i);
+        if (meshes_[entity] && aabbInFrustum(frustumPlanes, worldBounds_[entity])) {
+            visible[count++] = entity;
+        }
+    }
+    return count;
+}
+
+void Scene::clipMatrices(const glm::mat4& viewProj,
+    const EntityId* entities,
+    size_t count,
+    glm::mat4* out) const
+{
+    HAMON_TRACE_SCOPE("clip matrices");
+    if (count == 0) {
+        return;
+    }
+    // entity ids are rows of the columns
+    multiplyMatrices(viewProj, &worldMatrices_[EntityId(0)], entities, count, out);
+}
+
+void Scene::updateTransforms(ThreadPool* threadPool)
+{
+    HAMON_TRACE_SCOPE("update transforms");
+    if (!anyDirty_) {
+        return;
+    }
+
+    for (auto& level : dirtyLevels_) {
+        level.clear();
+    }
+    // parents come first, so one pass pushes dirtiness down whole subtrees
+    for (uint32_t i = 0; i < parents_.size(); ++i) {
+        EntityId entity(i);
+        EntityId parent = parents_[entity];
+        if (parent && dirty_[parent]) {
+            dirty_[entity] = 1;
+        }
+        if (!dirty_[entity]) {
+            continue;
+        }
+        uint32_t depth = depths_[entity];
+        if (depth >= dirtyLevels_.size()) {
+            dirtyLevels_.resize(depth + 1);
+        }
+        dirtyLevels_[depth].push_back(entity);
+    }
+
+    for (const auto& level : dirtyLevels_) {
+        auto updateRange = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                updateEntity(level[i]);
+            }
+        };
+        if (threadPool && level.size() >= PARALLEL_UPDATE_THRESHOLD) {
+            threadPool->parallelFor(level.size(), PARALLEL_UPDATE_BATCH, updateRange);
+        }
+        else {
+            updateRange(0, level.size());
+        }
+    }
+
+    for (const auto& level : dirtyLevels_) {
+        for (EntityId entity : level) {
+            dirty_[entity] = 0;
+        }
+    }
+    anyDirty_ = false;
+}
@@ -0,0 +1,85 @@
+#ifndef HAMON_SCENE_H__
+#define HAMON_SCENE_H__
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "StrongId.h"
+#include "LineraMap.h"
+#include "Mesh.h"
+
+class ThreadPool;
+
+struct EntityTag {};
+struct MeshTag {};
+struct MaterialTag {};
+typedef StrongId<EntityTag, uint32_t, UINT32_MAX> EntityId;
+typedef StrongId<MeshTag, uint32_t, UINT32_MAX> MeshId;
+typedef StrongId<MaterialTag, uint32_t, UINT32_MAX> MaterialId;
+
+Aabb transformAabb(const glm::mat4& matrix, const Aabb& aabb);
+// planes point inwards, as extractFrustumPlanes() returns them
+bool aabbInFrustum(const glm::vec4 planes[6], const Aabb& aabb);
+
+// Entities are rows of dense structure-of-arrays columns indexed by EntityId.
+// A parent is always created before its children, so the rows are in
+// topological order and one forward pass visits parents first.
+class Scene {
+public:
+    EntityId createEntity(EntityId parent = EntityId::INVALID());
+
+    void setTranslation(EntityId entity, const glm::vec3& translation);
+    void setRotation(EntityId entity, const glm::quat& rotation);
+    void setScale(EntityId entity, const glm::vec3& scale);
+    void setLocalBounds(EntityId entity, const Aabb& bounds);
+    void setMesh(EntityId entity, MeshId mesh) { meshes_[entity] = mesh; }
+    void setMaterial(EntityId entity, MaterialId material) { materials_[entity] = material; }
+
+    EntityId parent(EntityId entity) const { return parents_[entity]; }
+    MeshId mesh(EntityId entity) const { return meshes_[entity]; }
+    MaterialId material(EntityId entity) const { return materials_[entity]; }
+    // valid after updateTransforms()
+    const glm::mat4& worldMatrix(EntityId entity) const { return worldMatrices_[entity]; }
+    const Aabb& worldBounds(EntityId entity) const { return worldBounds_[entity]; }
+
+    size_t size() const { return parents_.size(); }
+
+    // Writes the entities with a mesh whose world bounds intersect the
+    // frustum to visible, which holds size() ids, returns how many.
+    size_t cullEntities(const glm::vec4 frustumPlanes[6], EntityId* visible) const;
+    // out[i] = viewProj * worldMatrix(entities[i]), one multiplyMatrices()
+    // batch
+    void clipMatrices(const glm::mat4& viewProj,
+        const EntityId* entities,
+        size_t count,
+        glm::mat4* out) const;
+
+    // Recomputes world matrices and bounds of dirty entities and their
+    // subtrees. Entities of the same depth are independent, large levels are
+    // spread over threadPool when one is given.
+    void updateTransforms(ThreadPool* threadPool = nullptr);
+private:
+    void markDirty(EntityId entity);
+    void updateEntity(EntityId entity);
+private:
+    // hierarchy
+    LinearMap<EntityId, EntityId> parents_;
+    LinearMap<EntityId, uint32_t> depths_;
+    // local transform
+    LinearMap<EntityId, glm::vec3> translations_;
+    LinearMap<EntityId, glm::quat> rotations_;
+    LinearMap<EntityId, glm::vec3> scales_;
+    LinearMap<EntityId, Aabb> localBounds_;
+    // derived
+    LinearMap<EntityId, glm::mat4> worldMatrices_;
+    LinearMap<EntityId, Aabb> worldBounds_;
+    // references
+    LinearMap<EntityId, MeshId> meshes_;
+    LinearMap<EntityId, MaterialId> materials_;
+
+    LinearMap<EntityId, uint8_t> dirty_;
+    bool anyDirty_ = false;
+    // dirty entities bucketed by depth, kept across updates to reuse memory
+    std::vector<std::vector<EntityId>> dirtyLevels_;
+};
+#endif
@@ -0,0 +1,389 @@
+#include "SimdMath.h"
+#include <math.h>
+
+#if !defined(HAMON_SIMD_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define HAMON_SIMD_AVX2 1
+#elif !defined(HAMON_SIMD_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HAMON_SIMD_SSE 1
+#elif !defined(HAMON_SIMD_SCALAR) && (defined(__aarch64__) || defined(_M_ARM64))
+// the lane broadcasts of the matrix product are AArch64 only
+#include <arm_neon.h>
+#define HAMON_SIMD_NEON 1
+#endif
+
+namespace {
+
+// Every SoA kernel is written once over a lane type: the vector of the
+// backend for the full groups and float for the tail.
+
+template<typename L> L load(const float* p);
+template<typename L> L set1(float value);
+// lanes from base[0], base[16], base[32]..., one float of consecutive mat4s
+template<typename L> L gatherMatrices(const float* base);
+
+template<> inline float load<float>(const float* p) { return *p; }
+template<> inline float set1<float>(float value) { return value; }
+template<> inline float gatherMatrices<float>(const float* base) { return *base; }
+inline void store(float* p, float a) { *p = a; }
+inline float add(float a, float b) { return a + b; }
+inline float sub(float a, float b) { return a - b; }
+inline float mul(float a, float b) { return a * b; }
+// a * b + c
+inline float madd(float a, float b, float c) { return a * b + c; }
+inline float absolute(float a) { return fabsf(a); }
+// bit i set if lane i of a >= b
+inline uint32_t greaterEqualMask(float a, float b) { return a >= b ? 1u : 0u; }
+
+#if HAMON_SIMD_AVX2
+typedef __m256 Lanes;
+static const size_t LANES = 8;
+
+template<> inline __m256 load<__m256>(const float* p) { return _mm256_loadu_ps(p); }
+template<> inline __m256 set1<__m256>(float value) { return _mm256_set1_ps(value); }
+template<> inline __m256 gatherMatrices<__m256>(const float* base)
+{
+    return _mm256_i32gather_ps(base, _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112), 4);
+}
+inline void store(float* p, __m256 a) { _mm256_storeu_ps(p, a); }
+inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+inline __m256 madd(__m256 a, __m256 b, __m256 c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+inline __m256 absolute(__m256 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+inline uint32_t greaterEqualMask(__m256 a, __m256 b)
+{
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ)));
+}
+#elif HAMON_SIMD_SSE
+typedef __m128 Lanes;
+static const size_t LANES = 4;
+
+template<> inline __m128 load<__m128>(const float* p) { return _mm_loadu_ps(p); }
+template<> inline __m128 set1<__m128>(float value) { return _mm_set1_ps(value); }
+// SSE4.1 builds turn this into insertps
+template<> inline __m128 gatherMatrices<__m128>(const float* base)
+{
+    return _mm_setr_ps(base[0], base[16], base[32], base[48]);
+}
+inline void store(float* p, __m128 a) { _mm_storeu_ps(p, a); }
+inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+inline __m128 madd(__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+inline __m128 absolute(__m128 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+inline uint32_t greaterEqualMask(__m128 a, __m128 b)
+{
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a, b)));
+}
+#elif HAMON_SIMD_NEON
+typedef float32x4_t Lanes;
+static const size_t LANES = 4;
+
+template<> inline float32x4_t load<float32x4_t>(const float* p) { return vld1q_f32(p); }
+template<> inline float32x4_t set1<float32x4_t>(float value) { return vdupq_n_f32(value); }
+template<> inline float32x4_t gatherMatrices<float32x4_t>(const float* base)
+{
+    float lanes[4] = {base[0], base[16], base[32], base[48]};
+    return vld1q_f32(lanes);
+}
+inline void store(float* p, float32x4_t a) { vst1q_f32(p, a); }
+inline float32x4_t add(float32x4_t a, float32x4_t b) { return vaddq_f32(a, b); }
+inline float32x4_t sub(float32x4_t a, float32x4_t b) { return vsubq_f32(a, b); }
+inline float32x4_t mul(float32x4_t a, float32x4_t b) { return vmulq_f32(a, b); }
+inline float32x4_t madd(float32x4_t a, float32x4_t b, float32x4_t c) { return vfmaq_f32(c, a, b); }
+inline float32x4_t absolute(float32x4_t a) { return vabsq_f32(a); }
+inline uint32_t greaterEqualMask(float32x4_t a, float32x4_t b)
+{
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vcgeq_f32(a, b), vld1q_u32(bits)));
+}
+#else
+typedef float Lanes;
+static const size_t LANES = 1;
+#endif
+
+}
+
+const char* simdMathBackend()
+{
+#if HAMON_SIMD_AVX2
+    return "avx2";
+#elif HAMON_SIMD_SSE && (defined(__SSE4_1__) || defined(__AVX__))
+    return "sse4";
+#elif HAMON_SIMD_SSE
+    return "sse2";
+#elif HAMON_SIMD_NEON
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+uint32_t simdMathWidth()
+{
+    return static_cast<uint32_t>(LANES);
+}
+
+// rightAt(i) is the i-th right hand matrix, both public variants share the
+// loop so the gather costs no extra pass
+template<typename RightAt>
+static void multiplyBatch(const glm::mat4& left,
+    size_t count,
+    glm::mat4* out,
+    RightAt rightAt)
+{
+    // column j of a product is left's columns weighted by column j of right,
+    // left's columns stay in registers for the whole batch
+    const float* l = &left[0][0];
+#if HAMON_SIMD_AVX2
+    // two columns at a time, each 128 bit half broadcasts its own weights
+    const __m256 column0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(l));
+    const __m256 column1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(l + 4));
+    const __m256 column2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(l + 8));
+    const __m256 column3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(l + 12));
+    for (size_t i = 0; i < count; ++i) {
+        const float* r = &rightAt(i)[0][0];
+        float* result = &out[i][0][0];
+        const __m256 r01 = _mm256_loadu_ps(r);
+        const __m256 r23 = _mm256_loadu_ps(r + 8);
+        __m256 sum01 = mul(column0, _mm256_permute_ps(r01, 0x00));
+        __m256 sum23 = mul(column0, _mm256_permute_ps(r23, 0x00));
+        sum01 = madd(column1, _mm256_permute_ps(r01, 0x55), sum01);
+        sum23 = madd(column1, _mm256_permute_ps(r23, 0x55), sum23);
+        sum01 = madd(column2, _mm256_permute_ps(r01, 0xaa), sum01);
+        sum23 = madd(column2, _mm256_permute_ps(r23, 0xaa), sum23);
+        sum01 = madd(column3, _mm256_permute_ps(r01, 0xff), sum01);
+        sum23 = madd(column3, _mm256_permute_ps(r23, 0xff), sum23);
+        _mm256_storeu_ps(result, sum01);
+        _mm256_storeu_ps(result + 8, sum23);
+    }
+#elif HAMON_SIMD_SSE
+    const __m128 column0 = _mm_loadu_ps(l);
+    const __m128 column1 = _mm_loadu_ps(l + 4);
+    const __m128 column2 = _mm_loadu_ps(l + 8);
+    const __m128 column3 = _mm_loadu_ps(l + 12);
+    for (size_t i = 0; i < count; ++i) {
+        const float* r = &rightAt(i)[0][0];
+        float* result = &out[i][0][0];
+        // all of right is read before out is written, they may alias
+        __m128 columns[4] = {_mm_loadu_ps(r), _mm_loadu_ps(r + 4), _mm_loadu_ps(r + 8), _mm_loadu_ps(r + 12)};
+        for (int j = 0; j < 4; ++j) {
+            const __m128 c = columns[j];
+            __m128 sum = mul(column0, _mm_shuffle_ps(c, c, 0x00));
+            sum = madd(column1, _mm_shuffle_ps(c, c, 0x55), sum);
+            sum = madd(column2, _mm_shuffle_ps(c, c, 0xaa), sum);
+            sum = madd(column3, _mm_shuffle_ps(c, c, 0xff), sum);
+            _mm_storeu_ps(result + j * 4, sum);
+        }
+    }
+#elif HAMON_SIMD_NEON
+    const float32x4_t column0 = vld1q_f32(l);
+    const float32x4_t column1 = vld1q_f32(l + 4);
+    const float32x4_t column2 = vld1q_f32(l + 8);
+    const float32x4_t column3 = vld1q_f32(l + 12);
+    for (size_t i = 0; i < count; ++i) {
+        const float* r = &rightAt(i)[0][0];
+        float* result = &out[i][0][0];
+        float32x4_t columns[4] = {vld1q_f32(r), vld1q_f32(r + 4), vld1q_f32(r + 8), vld1q_f32(r + 12)};
+        for (int j = 0; j < 4; ++j) {
+            float32x4_t sum = vmulq_laneq_f32(column0, columns[j], 0);
+            sum = vfmaq_laneq_f32(sum, column1, columns[j], 1);
+            sum = vfmaq_laneq_f32(sum, column2, columns[j], 2);
+            sum = vfmaq_laneq_f32(sum, column3, columns[j], 3);
+            vst1q_f32(result + j * 4, sum);
+        }
+    }
+#else
+    (void)l;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = left * rightAt(i);
+    }
+#endif
+}
+
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* right,
+    size_t count,
+    glm::mat4* out)
+{
+    multiplyBatch(left, count, out, [right](size_t i) -> const glm::mat4& {
+        return right[i];
+    });
+}
+
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* matrices,
+    const uint32_t* indices,
+    size_t count,
+    glm::mat4* out)
+{
+    multiplyBatch(left, count, out, [matrices, indices](size_t i) -> const glm::mat4& {
+        return matrices[indices[i]];
+    });
+}
+
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* matrices,
+    const EntityId* entities,
+    size_t count,
+    glm::mat4* out)
+{
+    multiplyBatch(left, count, out, [matrices, entities](size_t i) -> const glm::mat4& {
+        return matrices[entities[i].value()];
+    });
+}
+
+template<typename L>
+static void transformAabbLanes(const glm::mat4* matrices,
+    const AabbArrays& local,
+    size_t i,
+    const AabbArrays& world)
+{
+    const L half = set1<L>(0.5f);
+    const L minX = load<L>(local.minX + i);
+    const L minY = load<L>(local.minY + i);
+    const L minZ = load<L>(local.minZ + i);
+    const L maxX = load<L>(local.maxX + i);
+    const L maxY = load<L>(local.maxY + i);
+    const L maxZ = load<L>(local.maxZ + i);
+    const L centerX = mul(add(minX, maxX), half);
+    const L centerY = mul(add(minY, maxY), half);
+    const L centerZ = mul(add(minZ, maxZ), half);
+    const L extentX = mul(sub(maxX, minX), half);
+    const L extentY = mul(sub(maxY, minY), half);
+    const L extentZ = mul(sub(maxZ, minZ), half);
+
+    float* const worldMin[3] = {world.minX, world.minY, world.minZ};
+    float* const worldMax[3] = {world.maxX, world.maxY, world.maxZ};
+    const float* m = &matrices[i][0][0];
+    for (int row = 0; row < 3; ++row) {
+        const L m0 = gatherMatrices<L>(m + row);
+        const L m1 = gatherMatrices<L>(m + 4 + row);
+        const L m2 = gatherMatrices<L>(m + 8 + row);
+        const L m3 = gatherMatrices<L>(m + 12 + row);
+        const L center = madd(m0, centerX, madd(m1, centerY, madd(m2, centerZ, m3)));
+        const L extent = madd(absolute(m0), extentX,
+            madd(absolute(m1), extentY, mul(absolute(m2), extentZ)));
+        store(worldMin[row] + i, sub(center, extent));
+        store(worldMax[row] + i, add(center, extent));
+    }
+}
+
+void transformAabbs(const glm::mat4* matrices,
+    const AabbArrays& local,
+    size_t count,
+    const AabbArrays& world)
+{
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        transformAabbLanes<Lanes>(matrices, local, i, world);
+    }
+    for (; i < count; ++i) {
+        transformAabbLanes<float>(matrices, local, i, world);
+    }
+}
+
+template<typename L>
+static uint32_t cullSphereLanes(const glm::vec4 planes[6], const SphereArrays& spheres, size_t i)
+{
+    const L x = load<L>(spheres.x + i);
+    const L y = load<L>(spheres.y + i);
+    const L z = load<L>(spheres.z + i);
+    const L negativeRadius = sub(set1<L>(0.f), load<L>(spheres.radius + i));
+    uint32_t inside = ~0u;
+    for (int p = 0; p < 6; ++p) {
+        const L distance = madd(set1<L>(planes[p].x), x,
+            madd(set1<L>(planes[p].y), y,
+            madd(set1<L>(planes[p].z), z, set1<L>(planes[p].w))));
+        inside &= greaterEqualMask(distance, negativeRadius);
+    }
+    return inside;
+}
+
+size_t cullSpheres(const glm::vec4 planes[6],
+    const SphereArrays& spheres,
+    size_t count,
+    uint32_t* visible)
+{
+    size_t visibleCount = 0;
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        uint32_t inside = cullSphereLanes<Lanes>(planes, spheres, i);
+        for (uint32_t lane = 0; lane < LANES; ++lane) {
+            if (inside & (1u << lane)) {
+                visible[visibleCount++] = static_cast<uint32_t>(i + lane);
+            }
+        }
+    }
+    for (; i < count; ++i) {
+        if (cullSphereLanes<float>(planes, spheres, i) & 1u) {
+            visible[visibleCount++] = static_cast<uint32_t>(i);
+        }
+    }
+    return visibleCount;
+}
+
+template<typename L, size_t WIDTH>
+static void quatToMatrixLanes(const QuatArrays& rotations, size_t i, glm::mat4* out)
+{
+    const L x = load<L>(rotations.x + i);
+    const L y = load<L>(rotations.y + i);
+    const L z = load<L>(rotations.z + i);
+    const L w = load<L>(rotations.w + i);
+    const L one = set1<L>(1.f);
+    const L two = set1<L>(2.f);
+    const L xx = mul(x, x);
+    const L yy = mul(y, y);
+    const L zz = mul(z, z);
+    const L xy = mul(x, y);
+    const L xz = mul(x, z);
+    const L yz = mul(y, z);
+    const L wx = mul(w, x);
+    const L wy = mul(w, y);
+    const L wz = mul(w, z);
+
+    // [column][row] of the rotation, as glm::mat3_cast
+    float elements[3][3][WIDTH];
+    store(elements[0][0], sub(one, mul(two, add(yy, zz))));
+    store(elements[0][1], mul(two, add(xy, wz)));
+    store(elements[0][2], mul(two, sub(xz, wy)));
+    store(elements[1][0], mul(two, sub(xy, wz)));
+    store(elements[1][1], sub(one, mul(two, add(xx, zz))));
+    store(elements[1][2], mul(two, add(yz, wx)));
+    store(elements[2][0], mul(two, add(xz, wy)));
+    store(elements[2][1], mul(two, sub(yz, wx)));
+    store(elements[2][2], sub(one, mul(two, add(xx, yy))));
+    for (size_t lane = 0; lane < WIDTH; ++lane) {
+        glm::mat4& matrix = out[i + lane];
+        for (int column = 0; column < 3; ++column) {
+            matrix[column] = glm::vec4(elements[column][0][lane],
+                elements[column][1][lane],
+                elements[column][2][lane],
+                0.f);
+        }
+        matrix[3] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    }
+}
+
+void quatsToMatrices(const QuatArrays& rotations,
+    size_t count,
+    glm::mat4* out)
+{
+    size_t i = 0;
+    for (; i + LANES <= count; i += LANES) {
+        quatToMatrixLanes<Lanes, LANES>(rotations, i, out);
+    }
+    for (; i < count; ++i) {
+        quatToMatrixLanes<float, 1>(rotations, i, out);
+    }
+}
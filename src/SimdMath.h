@@ -0,0 +1,87 @@
+#ifndef HAMON_SIMD_MATH_H__
+#define HAMON_SIMD_MATH_H__
+#include <stddef.h>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "StrongId.h"
+
+// Batch kernels for the per object math of large scenes. Objects are lanes:
+// AVX2 builds process 8 at a time, SSE and NEON 4, HAMON_SIMD_SCALAR builds
+// (or other targets) one. The instruction set is the compiler's, see
+// HAMON_SIMD in CMakeLIsts.txt. Results match the glm equivalents up to
+// rounding, FMA builds differ in the last bits.
+//
+// Arrays of matrices stay glm::mat4, that is what the GPU consumes. Bounds,
+// spheres and rotations are structure-of-arrays, every array holds count
+// floats.
+
+// Scene's entity ids, without pulling in Scene.h
+struct EntityTag;
+typedef StrongId<EntityTag, uint32_t, UINT32_MAX> EntityId;
+
+struct AabbArrays {
+    float* minX;
+    float* minY;
+    float* minZ;
+    float* maxX;
+    float* maxY;
+    float* maxZ;
+};
+
+struct SphereArrays {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* radius;
+};
+
+struct QuatArrays {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* w;
+};
+
+// "avx2", "sse4", "sse2", "neon" or "scalar"
+const char* simdMathBackend();
+// objects per iteration of the SoA kernels
+uint32_t simdMathWidth();
+
+// out[i] = left * right[i], right and out may be the same array
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* right,
+    size_t count,
+    glm::mat4* out);
+// out[i] = left * matrices[indices[i]], gathers as it goes
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* matrices,
+    const uint32_t* indices,
+    size_t count,
+    glm::mat4* out);
+// out[i] = left * matrices[entities[i].value()]
+void multiplyMatrices(const glm::mat4& left,
+    const glm::mat4* matrices,
+    const EntityId* entities,
+    size_t count,
+    glm::mat4* out);
+
+// world[i] = the bounds of local[i] transformed by matrices[i], as
+// transformAabb() computes them. world may alias local.
+void transformAabbs(const glm::mat4* matrices,
+    const AabbArrays& local,
+    size_t count,
+    const AabbArrays& world);
+
+// Writes the indices of the spheres inside or touching all planes (pointing
+// inwards, as extractFrustumPlanes() returns them) to visible, which holds
+// count entries, returns how many.
+size_t cullSpheres(const glm::vec4 planes[6],
+    const SphereArrays& spheres,
+    size_t count,
+    uint32_t* visible);
+
+// out[i] = glm::mat4_cast of the unit quaternion i
+void quatsToMatrices(const QuatArrays& rotations,
+    size_t count,
+    glm::mat4* out);
+#endif
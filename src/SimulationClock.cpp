@@ -0,0 +1,30 @@
+#include "SimulationClock.h"
+
+SimulationClock::SimulationClock(ClockMode mode, double fixedStep)
+    : mode_(mode)
+    , fixedStep_(fixedStep)
+{
+    reset();
+}
+
+void SimulationClock::reset()
+{
+    frame_ = 0;
+    time_ = 0.0;
+    deltaTime_ = 0.0;
+    start_ = std::chrono::steady_clock::now();
+}
+
+void SimulationClock::advance()
+{
+    frame_++;
+    double previous = time_;
+    if (mode_ == ClockMode::FixedStep) {
+        // multiply instead of accumulating, so frame N is bit-exact
+        time_ = frame_ * fixedStep_;
+    }
+    else {
+        time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+    deltaTime_ = time_ - previous;
+}
@@ -0,0 +1,38 @@
+#ifndef HAMON_SIMULATION_CLOCK_H__
+#define HAMON_SIMULATION_CLOCK_H__
+#include <stdint.h>
+#include <chrono>
+
+enum class ClockMode {
+    RealTime,  // wall clock time since the first frame
+    FixedStep, // frame N is always at N * fixedStep, for reproducible runs
+};
+
+// Time seen by the simulation / animation. time() is sampled once per frame
+// by advance(), so everything within a frame sees the same value.
+class SimulationClock {
+public:
+    explicit SimulationClock(ClockMode mode = ClockMode::RealTime, double fixedStep = 1.0 / 60.0);
+
+    // back to frame 0 / time 0
+    void reset();
+
+    // moves to the next frame, call once per frame after it was recorded
+    void advance();
+
+    ClockMode mode() const { return mode_; }
+    uint64_t frame() const { return frame_; }
+    // seconds since frame 0
+    double time() const { return time_; }
+    // seconds between the previous frame and this one, 0 on frame 0
+    double deltaTime() const { return deltaTime_; }
+private:
+    ClockMode mode_;
+    double fixedStep_;
+    uint64_t frame_ = 0;
+    double time_ = 0.0;
+    double deltaTime_ = 0.0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#endif
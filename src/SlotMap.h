@@ -0,0 +1,160 @@
+#ifndef HAMON_SLOTMAP_H__
+#define HAMON_SLOTMAP_H__
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <assert.h>
+#include "StrongId.h"
+#include "LineraMap.h"
+
+//Handle into a SlotMap: slot index in the low 32 bits, slot generation in the
+//high 32 bits. The generation is bumped every time the slot is released, so a
+//handle kept after erase() no longer matches and is detected as stale.
+template<typename tag>
+using SlotHandle = StrongId<tag, uint64_t, UINT64_MAX>;
+
+//A container with stable handles, O(1) insert/erase/lookup and values stored
+//densely for cache friendly iteration (erase moves the last value into the
+//hole, so iteration order is not insertion order).
+//
+//Released slots are kept in a free list and reused with a new generation.
+//find()/contains() always validate the generation; operator[] only does so
+//with asserts enabled, catching use-after-free in debug builds at no cost in
+//release builds.
+template<typename tag, typename V>
+class SlotMap {
+    public: //Public types
+        typedef SlotHandle<tag> Handle;
+        typedef typename std::vector<V>::iterator iterator;
+        typedef typename std::vector<V>::const_iterator const_iterator;
+
+    public: //Accessors
+        bool contains(const Handle handle) const { return slotOf(handle) != nullptr; }
+
+        const V* find(const Handle handle) const {
+            const Slot* slot = slotOf(handle);
+            return slot ? &values_[slot->index] : nullptr;
+        }
+
+        const V& operator[](const Handle handle) const {
+            assert(contains(handle) && "Stale or invalid handle");
+            return values_[slots_[indexOf(handle)].index];
+        }
+
+        //Handle of the value at a dense position, for iteration with handles
+        Handle handleAt(std::size_t denseIndex) const {
+            uint32_t slotIndex = denseToSlot_[denseIndex];
+            return makeHandle(slotIndex, slots_[slotIndex].generation);
+        }
+
+        const_iterator begin() const { return values_.begin(); }
+        const_iterator end() const { return values_.end(); }
+        std::size_t size() const { return values_.size(); }
+        bool empty() const { return values_.empty(); }
+
+    public: //Mutators
+        Handle insert(V value) { return emplace(std::move(value)); }
+
+        template<typename... Args>
+        Handle emplace(Args&&... args) {
+            uint32_t slotIndex;
+            if (freeHead_ != FREE_LIST_END) {
+                slotIndex = freeHead_;
+                freeHead_ = slots_[slotIndex].index;
+            } else {
+                slotIndex = static_cast<uint32_t>(slots_.size());
+                slots_.push_back(Slot{0, 0});
+            }
+            Slot& slot = slots_[slotIndex];
+            slot.index = static_cast<uint32_t>(values_.size());
+            values_.emplace_back(std::forward<Args>(args)...);
+            denseToSlot_.push_back(slotIndex);
+            return makeHandle(slotIndex, slot.generation);
+        }
+
+        //Returns false if the handle was already stale
+        bool erase(const Handle handle) {
+            Slot* slot = slotOf(handle);
+            if (slot == nullptr) {
+                return false;
+            }
+            uint32_t slotIndex = indexOf(handle);
+            uint32_t denseIndex = slot->index;
+            uint32_t lastIndex = static_cast<uint32_t>(values_.size() - 1);
+            if (denseIndex != lastIndex) {
+                values_[denseIndex] = std::move(values_[lastIndex]);
+                denseToSlot_[denseIndex] = denseToSlot_[lastIndex];
+                slots_[denseToSlot_[denseIndex]].index = denseIndex;
+            }
+            values_.pop_back();
+            denseToSlot_.pop_back();
+
+            slot->generation++;
+            slot->index = freeHead_;
+            freeHead_ = slotIndex;
+            return true;
+        }
+
+        V* find(const Handle handle) {
+            Slot* slot = slotOf(handle);
+            return slot ? &values_[slot->index] : nullptr;
+        }
+
+        V& operator[](const Handle handle) {
+            assert(contains(handle) && "Stale or invalid handle");
+            return values_[slots_[indexOf(handle)].index];
+        }
+
+        iterator begin() { return values_.begin(); }
+        iterator end() { return values_.end(); }
+
+        //Invalidates every outstanding handle
+        void clear() {
+            for (uint32_t i = 0; i < denseToSlot_.size(); ++i) {
+                uint32_t slotIndex = denseToSlot_[i];
+                slots_[slotIndex].generation++;
+                slots_[slotIndex].index = freeHead_;
+                freeHead_ = slotIndex;
+            }
+            values_.clear();
+            denseToSlot_.clear();
+        }
+
+    private:
+        //index: dense position while live, next free slot while released
+        struct Slot {
+            uint32_t generation;
+            uint32_t index;
+        };
+
+        static const uint32_t FREE_LIST_END = UINT32_MAX;
+
+        static Handle makeHandle(uint32_t slotIndex, uint32_t generation) {
+            return Handle((static_cast<uint64_t>(generation) << 32) | slotIndex);
+        }
+        static uint32_t indexOf(const Handle handle) {
+            return static_cast<uint32_t>(handle.value() & 0xffffffffu);
+        }
+        static uint32_t generationOf(const Handle handle) {
+            return static_cast<uint32_t>(handle.value() >> 32);
+        }
+
+        const Slot* slotOf(const Handle handle) const {
+            if (!handle || !slots_.contain(indexOf(handle))) {
+                return nullptr;
+            }
+            const Slot& slot = slots_[indexOf(handle)];
+            return slot.generation == generationOf(handle) && slot.index < values_.size() &&
+                denseToSlot_[slot.index] == indexOf(handle) ? &slot : nullptr;
+        }
+        Slot* slotOf(const Handle handle) {
+            return const_cast<Slot*>(static_cast<const SlotMap*>(this)->slotOf(handle));
+        }
+    private:
+        LinearMap<uint32_t, Slot> slots_;
+        std::vector<V> values_;
+        std::vector<uint32_t> denseToSlot_;
+        uint32_t freeHead_ = FREE_LIST_END;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "StartupTimeline.h"
+#include <stdio.h>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct PhaseRecord {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    std::thread::id thread;
+};
+
+// startup is short and phases are coarse, a lock is fine here
+std::mutex phaseMutex;
+std::vector<PhaseRecord> phases;
+uint64_t startupBegin = 0;
+uint64_t startupEnd = 0;
+bool ended = false;
+std::thread::id mainThread;
+
+} // namespace
+
+void beginStartup()
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    startupBegin = traceNow();
+    mainThread = std::this_thread::get_id();
+}
+
+void endStartup()
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    if (ended) {
+        return;
+    }
+    startupEnd = traceNow();
+    ended = true;
+}
+
+bool startupEnded()
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    return ended;
+}
+
+double timeToFirstFrameMs()
+{
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    return ended ? (startupEnd - startupBegin) * 1e-6 : 0.0;
+}
+
+void recordStartupPhase(const char* name, uint64_t startNs, uint64_t endNs)
+{
+#if HAMON_ENABLE_TRACING
+    traceRecord(name, startNs, endNs);
+#endif
+    std::lock_guard<std::mutex> lock(phaseMutex);
+    if (ended) {
+        return;
+    }
+    phases.push_back({name, startNs, endNs, std::this_thread::get_id()});
+}
+
+std::string startupReport()
+{
+    std::vector<PhaseRecord> sorted;
+    uint64_t origin = 0;
+    uint64_t end = 0;
+    bool complete = false;
+    std::thread::id main;
+    {
+        std::lock_guard<std::mutex> lock(phaseMutex);
+        sorted = phases;
+        origin = startupBegin;
+        end = startupEnd;
+        complete = ended;
+        main = mainThread;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const PhaseRecord& a, const PhaseRecord& b) {
+        return a.start < b.start;
+    });
+
+    // main thread is 0, workers are numbered in order of appearance
+    std::vector<std::thread::id> threads(1, main);
+    std::string text;
+    char line[160];
+    snprintf(line, sizeof(line), "%-28s %6s %10s %10s\n", "startup phase", "thread", "start ms", "ms");
+    text += line;
+    for (const PhaseRecord& phase : sorted) {
+        size_t thread = std::find(threads.begin(), threads.end(), phase.thread) - threads.begin();
+        if (thread == threads.size()) {
+            threads.push_back(phase.thread);
+        }
+        uint64_t start = phase.start > origin ? phase.start - origin : 0;
+        snprintf(line, sizeof(line), "%-28s %6zu %10.2f %10.2f\n",
+            phase.name,
+            thread,
+            start * 1e-6,
+            (phase.end - phase.start) * 1e-6);
+        text += line;
+    }
+    if (complete) {
+        snprintf(line, sizeof(line), "%-28s %6s %10.2f\n", "first frame", "", (end - origin) * 1e-6);
+        text += line;
+    }
+    return text;
+}
@@ -0,0 +1,42 @@
+#ifndef HAMON_STARTUP_TIMELINE_H__
+#define HAMON_STARTUP_TIMELINE_H__
+#include <stdint.h>
+#include <string>
+#include "Trace.h"
+
+// Wall clock phases from process start to the first submitted frame. Phases
+// may overlap and run on any thread; each one is also recorded as a trace
+// zone.
+//
+//     {
+//         HAMON_STARTUP_PHASE("create device");
+//         device_ = createDevice(...);
+//     }
+
+// origin of the timeline, call first thing in main
+void beginStartup();
+// first call ends startup (time to first frame), later calls are ignored
+void endStartup();
+bool startupEnded();
+double timeToFirstFrameMs();
+
+// name must outlive the timeline (string literals)
+void recordStartupPhase(const char* name, uint64_t startNs, uint64_t endNs);
+
+// phases sorted by start time, with the thread they ran on
+std::string startupReport();
+
+class StartupPhase {
+public:
+    explicit StartupPhase(const char* name) : name_(name), start_(traceNow()) {}
+    ~StartupPhase() { recordStartupPhase(name_, start_, traceNow()); }
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+#define HAMON_STARTUP_PHASE(name) StartupPhase HAMON_TRACE_CONCAT(startupPhase_, __LINE__)(name)
+
+#endif
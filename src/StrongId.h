@@ -45,6 +45,9 @@ class StrongId {
         //Allow explicit conversion to size_t (e.g. my_vector[size_t(strong_id)])
         explicit operator std::size_t() const { return static_cast<std::size_t>(id_); }
 
+        //Raw underlying value (e.g. for ids that pack several fields)
+        constexpr T value() const { return id_; }
+
 
         //To enable hasing Ids
         friend std::hash<StrongId<tag,T,sentinel>>;
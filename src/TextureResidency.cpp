@@ -0,0 +1,358 @@
+#include "TextureResidency.h"
+#include "ImageStateTracker.h"
+#include "VulkanUtils.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, TextureData& texture)
+{
+    texture.mips.clear();
+    size_t size = 0;
+    for (uint32_t w = width, h = height; ; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+        TextureMip mip = {w, h, size, size_t(w) * h * 4};
+        texture.mips.push_back(mip);
+        size += mip.size;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    texture.pixels.resize(size);
+    memcpy(texture.pixels.data(), rgba, texture.mips[0].size);
+
+    for (size_t level = 1; level < texture.mips.size(); ++level) {
+        const TextureMip& src = texture.mips[level - 1];
+        const TextureMip& dst = texture.mips[level];
+        const uint8_t* srcPixels = texture.pixels.data() + src.offset;
+        uint8_t* dstPixels = texture.pixels.data() + dst.offset;
+        for (uint32_t y = 0; y < dst.height; ++y) {
+            // odd sizes repeat the last row / column
+            uint32_t y0 = std::min(y * 2, src.height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+            for (uint32_t x = 0; x < dst.width; ++x) {
+                uint32_t x0 = std::min(x * 2, src.width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+                for (uint32_t c = 0; c < 4; ++c) {
+                    uint32_t sum = srcPixels[(y0 * src.width + x0) * 4 + c] +
+                        srcPixels[(y0 * src.width + x1) * 4 + c] +
+                        srcPixels[(y1 * src.width + x0) * 4 + c] +
+                        srcPixels[(y1 * src.width + x1) * 4 + c];
+                    dstPixels[(y * dst.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+void TextureResidency::init(GpuResources* resources,
+    ImageStateTracker* imageStates,
+    VkDevice device,
+    VkQueue queue,
+    VkCommandPool commandPool,
+    ThreadPool* threadPool,
+    const TextureResidencyDesc& desc)
+{
+    resources_ = resources;
+    imageStates_ = imageStates;
+    device_ = device;
+    queue_ = queue;
+    commandPool_ = commandPool;
+    threadPool_ = threadPool;
+    desc_ = desc;
+}
+
+void TextureResidency::shutdown()
+{
+    for (auto& job : jobs_) {
+        job->ready.wait();
+    }
+    jobs_.clear();
+    finished_.clear();
+    textures_.clear();
+    residentBytes_ = 0;
+}
+
+TextureResidency::TextureId TextureResidency::addTexture(TextureData&& data)
+{
+    Texture texture = {};
+    texture.data = std::make_shared<const TextureData>(std::move(data));
+    const std::vector<TextureMip>& mips = texture.data->mips;
+    texture.tailMip = static_cast<uint32_t>(mips.size()) - 1;
+    for (uint32_t i = 0; i < mips.size(); ++i) {
+        if (std::max(mips[i].width, mips[i].height) <= desc_.minResidentSize) {
+            texture.tailMip = i;
+            break;
+        }
+    }
+    texture.lastUsedFrame = frame_;
+    texture.wantedMip = desc_.budget == 0 ? 0 : texture.tailMip;
+    texture.residentMip = texture.wantedMip;
+    TextureId id = static_cast<TextureId>(textures_.size());
+    textures_.push_back(texture);
+
+    startJob(id, texture.wantedMip);
+    VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(device_, commandPool_);
+    recordUploads(commandBuffer, true);
+    endSingleTimeCommandBuffer(device_, queue_, commandPool_, commandBuffer);
+    return id;
+}
+
+void TextureResidency::requestTexels(TextureId texture, uint64_t frame, float texels)
+{
+    Texture& entry = textures_[texture];
+    if (entry.lastUsedFrame != frame) {
+        entry.lastUsedFrame = frame;
+        entry.texels = 0.f;
+    }
+    entry.texels = std::max(entry.texels, texels);
+}
+
+VkDeviceSize TextureResidency::bytesFrom(const Texture& texture, uint32_t mip) const
+{
+    return texture.data->pixels.size() - texture.data->mips[mip].offset;
+}
+
+void TextureResidency::update(VkCommandBuffer commandBuffer, uint64_t frame)
+{
+    HAMON_TRACE_SCOPE("texture residency");
+    frame_ = frame;
+    recordUploads(commandBuffer, false);
+
+    for (Texture& texture : textures_) {
+        if (texture.lastUsedFrame + desc_.unusedFrames < frame) {
+            texture.wantedMip = texture.tailMip;
+            continue;
+        }
+        // one texel per pixel, more detail than that only aliases
+        const TextureMip& top = texture.data->mips[0];
+        float size = static_cast<float>(std::max(top.width, top.height));
+        uint32_t neededMip = 0;
+        if (texture.texels < size) {
+            neededMip = static_cast<uint32_t>(log2f(size / std::max(texture.texels, 1.f)));
+        }
+        // on screen need only streams in, dropping is left to the budget
+        // and to unused textures so a mip boundary doesn't flip every frame
+        texture.wantedMip = std::min(std::min(neededMip, texture.tailMip), texture.residentMip);
+    }
+    fitBudget(frame);
+
+    VkDeviceSize uploadBytes = 0;
+    for (TextureId id = 0; id < textures_.size(); ++id) {
+        if (jobs_.size() >= desc_.maxStreamingJobs) {
+            break;
+        }
+        Texture& texture = textures_[id];
+        if (texture.streaming || texture.wantedMip == texture.residentMip) {
+            continue;
+        }
+        // levels that aren't resident yet, dropping mips uploads nothing new
+        auto newBytes = [&](uint32_t mip) -> VkDeviceSize {
+            return mip < texture.residentMip ?
+                bytesFrom(texture, mip) - bytesFrom(texture, texture.residentMip) : 0;
+        };
+        // stream in as much as the frame allows, the rest comes next time
+        uint32_t mip = texture.wantedMip;
+        while (mip < texture.residentMip &&
+            uploadBytes + newBytes(mip) > desc_.uploadBytesPerFrame) {
+            ++mip;
+        }
+        if (mip == texture.residentMip) {
+            // a level larger than the frame's share still streams in, one
+            // level per frame and as the frame's only stream-in
+            if (uploadBytes != 0) {
+                continue;
+            }
+            mip = texture.residentMip - 1;
+        }
+        uploadBytes += newBytes(mip);
+        startJob(id, mip);
+    }
+}
+
+void TextureResidency::fitBudget(uint64_t frame)
+{
+    if (desc_.budget == 0) {
+        return;
+    }
+    VkDeviceSize total = 0;
+    for (const Texture& texture : textures_) {
+        total += bytesFrom(texture, texture.wantedMip);
+    }
+    if (total <= desc_.budget) {
+        return;
+    }
+
+    // least recently used and smallest on screen give up mips first, one
+    // level per texture per pass
+    order_.resize(textures_.size());
+    for (TextureId id = 0; id < order_.size(); ++id) {
+        order_[id] = id;
+    }
+    std::sort(order_.begin(), order_.end(), [this](TextureId a, TextureId b) {
+        const Texture& textureA = textures_[a];
+        const Texture& textureB = textures_[b];
+        if (textureA.lastUsedFrame != textureB.lastUsedFrame) {
+            return textureA.lastUsedFrame < textureB.lastUsedFrame;
+        }
+        return textureA.texels < textureB.texels;
+    });
+    bool dropped = true;
+    while (dropped && total > desc_.budget) {
+        dropped = false;
+        for (TextureId id : order_) {
+            Texture& texture = textures_[id];
+            if (texture.wantedMip >= texture.tailMip) {
+                continue;
+            }
+            total -= bytesFrom(texture, texture.wantedMip) - bytesFrom(texture, texture.wantedMip + 1);
+            ++texture.wantedMip;
+            dropped = true;
+            if (total <= desc_.budget) {
+                return;
+            }
+        }
+    }
+}
+
+void TextureResidency::startJob(TextureId id, uint32_t mip)
+{
+    Texture& texture = textures_[id];
+    const TextureMip& top = texture.data->mips[mip];
+    uint32_t levels = static_cast<uint32_t>(texture.data->mips.size()) - mip;
+    VkDeviceSize size = bytesFrom(texture, mip);
+
+    std::unique_ptr<StreamJob> job(new StreamJob());
+    job->texture = id;
+    job->mip = mip;
+    job->image = resources_->createImage2D(MEMORY_CATEGORY_TEXTURE,
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        top.width,
+        top.height,
+        levels);
+    job->staging = resources_->createBuffer(MEMORY_CATEGORY_STAGING,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        size,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // the levels are contiguous, filling the staging buffer is one copy
+    std::shared_ptr<const TextureData> data = texture.data;
+    void* mapped = resources_->buffer(job->staging).mapped;
+    size_t offset = top.offset;
+    std::function<void()> fill = [data, mapped, offset, size] {
+        HAMON_TRACE_SCOPE("stream texture");
+        memcpy(mapped, data->pixels.data() + offset, size);
+    };
+    if (threadPool_ != nullptr) {
+        job->ready = threadPool_->submit(std::move(fill));
+    }
+    else {
+        std::packaged_task<void()> task(std::move(fill));
+        task();
+        job->ready = task.get_future();
+    }
+    texture.streaming = true;
+    jobs_.push_back(std::move(job));
+}
+
+uint32_t TextureResidency::recordUploads(VkCommandBuffer commandBuffer, bool wait)
+{
+    finished_.clear();
+    for (size_t i = 0; i < jobs_.size(); ) {
+        if (wait || jobs_[i]->ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            finished_.push_back(std::move(jobs_[i]));
+            jobs_[i] = std::move(jobs_.back());
+            jobs_.pop_back();
+            continue;
+        }
+        ++i;
+    }
+    if (finished_.empty()) {
+        return 0;
+    }
+
+    // one batch of barriers into the copies and one out of them
+    for (auto& job : finished_) {
+        job->ready.get();
+        const GpuImage& image = resources_->image(job->image);
+        imageStates_->registerImage(image.image, VK_IMAGE_ASPECT_COLOR_BIT, image.mipLevels, 1);
+        imageStates_->transition(commandBuffer, image.image, IMAGE_ACCESS_TRANSFER_WRITE, true);
+    }
+    imageStates_->flush(commandBuffer);
+
+    for (auto& job : finished_) {
+        const std::vector<TextureMip>& mips = textures_[job->texture].data->mips;
+        regions_.clear();
+        for (uint32_t level = job->mip; level < mips.size(); ++level) {
+            VkBufferImageCopy region = {};
+            region.bufferOffset = mips[level].offset - mips[job->mip].offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level - job->mip;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {0, 0, 0};
+            region.imageExtent = {mips[level].width, mips[level].height, 1};
+            regions_.push_back(region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer,
+            resources_->buffer(job->staging).buffer,
+            resources_->image(job->image).image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions_.size()),
+            regions_.data());
+    }
+
+    for (auto& job : finished_) {
+        imageStates_->transition(commandBuffer,
+            resources_->image(job->image).image,
+            IMAGE_ACCESS_FRAGMENT_SAMPLED);
+    }
+    imageStates_->flush(commandBuffer);
+
+    // frames already submitted may still sample the old image
+    for (auto& job : finished_) {
+        Texture& texture = textures_[job->texture];
+        if (resources_->isValid(texture.image)) {
+            residentBytes_ -= bytesFrom(texture, texture.residentMip);
+            imageStates_->forgetImage(resources_->image(texture.image).image);
+            resources_->release(texture.image, frame_);
+        }
+        resources_->release(job->staging, frame_);
+        texture.image = job->image;
+        texture.residentMip = job->mip;
+        texture.streaming = false;
+        ++texture.version;
+        residentBytes_ += bytesFrom(texture, job->mip);
+        streamedBytes_ += bytesFrom(texture, job->mip);
+    }
+    uint32_t count = static_cast<uint32_t>(finished_.size());
+    finished_.clear();
+    return count;
+}
+
+std::string TextureResidency::report() const
+{
+    uint32_t partial = 0;
+    for (const Texture& texture : textures_) {
+        if (texture.residentMip != 0) {
+            ++partial;
+        }
+    }
+    char line[256];
+    snprintf(line, sizeof(line),
+        "textures: %u, %u without top mips, %.2f MB resident (budget %.2f MB), "
+        "%u streaming, %.2f MB streamed\n",
+        textureCount(),
+        partial,
+        residentBytes_ / (1024.0 * 1024.0),
+        desc_.budget / (1024.0 * 1024.0),
+        static_cast<uint32_t>(jobs_.size()),
+        streamedBytes_ / (1024.0 * 1024.0));
+    return line;
+}
@@ -0,0 +1,134 @@
+#ifndef HAMON_TEXTURE_RESIDENCY_H__
+#define HAMON_TEXTURE_RESIDENCY_H__
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include "GpuResources.h"
+
+class ThreadPool;
+class ImageStateTracker;
+
+struct TextureMip {
+    uint32_t width;
+    uint32_t height;
+    // into TextureData::pixels
+    size_t offset;
+    size_t size;
+};
+
+// RGBA8 pixels of every mip, largest first and packed back to back, so the
+// levels [mip, end) are one contiguous range
+struct TextureData {
+    std::vector<uint8_t> pixels;
+    std::vector<TextureMip> mips;
+};
+
+// 2x2 box filtered chain down to 1x1
+void buildMipChain(const uint8_t* rgba, uint32_t width, uint32_t height, TextureData& texture);
+
+struct TextureResidencyDesc {
+    // device memory all textures may use together, 0 is unlimited
+    VkDeviceSize budget = 0;
+    // mips at or below this size are always resident
+    uint32_t minResidentSize = 64;
+    // frames without a request before a texture drops to its smallest mips
+    uint64_t unusedFrames = 120;
+    // bytes of new mips started streaming per frame, a single larger level
+    // still streams in alone
+    VkDeviceSize uploadBytesPerFrame = 8 * 1024 * 1024;
+    uint32_t maxStreamingJobs = 4;
+};
+
+// Keeps the top mips of each texture resident only when it is used and big
+// on screen. A partially resident texture is an image holding the levels
+// [residentMip, end), changing residency builds a new image from the CPU side
+// mip chain on the thread pool and swaps it in on a later frame; the old one
+// is released once the GPU is done with it.
+class TextureResidency {
+public:
+    typedef uint32_t TextureId;
+
+    // imageStates tracks the texture images, shared with whoever records
+    // into the same command buffers
+    void init(GpuResources* resources,
+        ImageStateTracker* imageStates,
+        VkDevice device,
+        VkQueue queue,
+        VkCommandPool commandPool,
+        ThreadPool* threadPool,
+        const TextureResidencyDesc& desc);
+
+    // waits for the streaming jobs, images are left to GpuResources::destroyAll
+    void shutdown();
+
+    // uploaded right away, every mip with an unlimited budget and the always
+    // resident tail otherwise
+    TextureId addTexture(TextureData&& texture);
+
+    // the texture is drawn in frame covering about texels pixels on screen
+    void requestTexels(TextureId texture, uint64_t frame, float texels);
+
+    // Picks the mips every texture should have, fits them in the budget,
+    // starts streaming jobs and records the uploads of the finished ones into
+    // commandBuffer. Call outside a render pass before the draws of frame.
+    void update(VkCommandBuffer commandBuffer, uint64_t frame);
+
+    // the image changes when version() does
+    ImageHandle image(TextureId texture) const { return textures_[texture].image; }
+    uint32_t version(TextureId texture) const { return textures_[texture].version; }
+    uint32_t residentMip(TextureId texture) const { return textures_[texture].residentMip; }
+    uint32_t textureCount() const { return static_cast<uint32_t>(textures_.size()); }
+    VkDeviceSize residentBytes() const { return residentBytes_; }
+    uint64_t streamedBytes() const { return streamedBytes_; }
+
+    std::string report() const;
+private:
+    struct Texture {
+        std::shared_ptr<const TextureData> data;
+        ImageHandle image;
+        uint32_t residentMip;
+        // smallest always resident mip
+        uint32_t tailMip;
+        uint32_t wantedMip;
+        uint64_t lastUsedFrame;
+        // largest request of lastUsedFrame
+        float texels;
+        uint32_t version;
+        bool streaming;
+    };
+
+    struct StreamJob {
+        TextureId texture;
+        uint32_t mip;
+        ImageHandle image;
+        BufferHandle staging;
+        std::future<void> ready;
+    };
+
+    VkDeviceSize bytesFrom(const Texture& texture, uint32_t mip) const;
+    void startJob(TextureId texture, uint32_t mip);
+    // copies and transitions every finished job, returns how many were recorded
+    uint32_t recordUploads(VkCommandBuffer commandBuffer, bool wait);
+    void fitBudget(uint64_t frame);
+private:
+    GpuResources* resources_ = nullptr;
+    ImageStateTracker* imageStates_ = nullptr;
+    VkDevice device_{VK_NULL_HANDLE};
+    VkQueue queue_{VK_NULL_HANDLE};
+    VkCommandPool commandPool_{VK_NULL_HANDLE};
+    ThreadPool* threadPool_ = nullptr;
+    TextureResidencyDesc desc_;
+    std::vector<Texture> textures_;
+    std::vector<std::unique_ptr<StreamJob>> jobs_;
+    VkDeviceSize residentBytes_ = 0;
+    uint64_t streamedBytes_ = 0;
+    uint64_t frame_ = 0;
+    // reused by update(), no allocation per frame once warmed up
+    std::vector<TextureId> order_;
+    std::vector<VkBufferImageCopy> regions_;
+    std::vector<std::unique_ptr<StreamJob>> finished_;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    workers_.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+    std::packaged_task<void()> packagedTask(std::move(task));
+    std::future<void> future = packagedTask.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(packagedTask));
+    }
+    condition_.notify_one();
+    return future;
+}
+
+void ThreadPool::parallelFor(size_t count,
+    size_t batchSize,
+    const std::function<void(size_t begin, size_t end)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+    batchSize = std::max<size_t>(batchSize, 1);
+    const size_t batchCount = (count + batchSize - 1) / batchSize;
+    if (batchCount == 1 || workers_.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    // Helpers sit in the same queue as pipeline compiles and texture fills,
+    // the caller only waits for the ones that started before it ran out of
+    // batches. Late helpers find the call closed and return without touching
+    // fn, so the state they share lives on the heap.
+    struct ParallelForState {
+        std::atomic<size_t> nextBatch;
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t running = 0;
+        bool closed = false;
+    };
+    auto state = std::make_shared<ParallelForState>();
+    state->nextBatch = 0;
+    const std::function<void(size_t, size_t)>* body = &fn;
+    auto runBatches = [state, body, batchCount, batchSize, count]() {
+        for (size_t batch = state->nextBatch++; batch < batchCount; batch = state->nextBatch++) {
+            size_t begin = batch * batchSize;
+            (*body)(begin, std::min(begin + batchSize, count));
+        }
+    };
+
+    size_t helperCount = std::min<size_t>(workers_.size(), batchCount - 1);
+    for (size_t i = 0; i < helperCount; ++i) {
+        submit([state, runBatches]() {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->closed) {
+                    return;
+                }
+                ++state->running;
+            }
+            runBatches();
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (--state->running == 0) {
+                state->finished.notify_all();
+            }
+        });
+    }
+    runBatches();
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->closed = true;
+    state->finished.wait(lock, [&]() { return state->running == 0; });
+}
+
+void ThreadPool::workerLoop()
+{
+    HAMON_TRACE_THREAD_NAME("worker");
+    for (;;) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef HAMON_THREAD_POOL_H__
+#define HAMON_THREAD_POOL_H__
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+
+// Fixed set of worker threads with a FIFO task queue.
+class ThreadPool {
+public:
+    // 0 picks one worker per hardware thread minus the calling thread
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> task);
+
+    // Runs fn(begin, end) over [0, count) in batches of batchSize, the
+    // calling thread takes part and the call returns once every batch is done.
+    // Helpers still queued behind other tasks by then are not waited for, so
+    // workers may call it too.
+    void parallelFor(size_t count,
+        size_t batchSize,
+        const std::function<void(size_t begin, size_t end)>& fn);
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(workers_.size()); }
+private:
+    void workerLoop();
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::packaged_task<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_ = false;
+};
+#endif
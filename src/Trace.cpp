@@ -0,0 +1,133 @@
+#include "Trace.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+static_assert((TRACE_EVENTS_PER_THREAD & (TRACE_EVENTS_PER_THREAD - 1)) == 0,
+    "the trace ring index is masked");
+
+// written by its owning thread only, count is published after the event.
+// count is every event ever recorded, the ring holds the newest of them.
+struct ThreadTrace {
+    uint32_t threadId;
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> count;
+    TraceEvent events[TRACE_EVENTS_PER_THREAD];
+};
+
+std::mutex& registryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// buffers are never freed so that events of finished threads can still be
+// exported
+std::vector<ThreadTrace*>& registry()
+{
+    static std::vector<ThreadTrace*> threads;
+    return threads;
+}
+
+ThreadTrace* threadTrace()
+{
+    static thread_local ThreadTrace* trace = nullptr;
+    if (trace == nullptr) {
+        trace = new ThreadTrace();
+        trace->name.store(nullptr, std::memory_order_relaxed);
+        trace->count.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(registryMutex());
+        trace->threadId = static_cast<uint32_t>(registry().size());
+        registry().push_back(trace);
+    }
+    return trace;
+}
+
+void writeEscaped(FILE* file, const char* text)
+{
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*text, file);
+    }
+}
+
+} // namespace
+
+uint64_t traceNow()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void traceRecord(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadTrace* trace = threadTrace();
+    uint64_t count = trace->count.load(std::memory_order_relaxed);
+    TraceEvent& event = trace->events[count & (TRACE_EVENTS_PER_THREAD - 1)];
+    event.name = name;
+    event.start = startNs;
+    event.end = endNs;
+    trace->count.store(count + 1, std::memory_order_release);
+}
+
+void traceSetThreadName(const char* name)
+{
+    threadTrace()->name.store(name, std::memory_order_release);
+}
+
+bool writeChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<ThreadTrace*> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        threads = registry();
+    }
+
+    // complete events ("X"), timestamps are in microseconds
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    uint64_t dropped = 0;
+    for (ThreadTrace* trace : threads) {
+        const char* threadName = trace->name.load(std::memory_order_acquire);
+        if (threadName != nullptr) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"",
+                first ? "" : ",\n", trace->threadId);
+            writeEscaped(file, threadName);
+            fprintf(file, "\"}}");
+            first = false;
+        }
+        uint64_t count = trace->count.load(std::memory_order_acquire);
+        uint64_t oldest = count > TRACE_EVENTS_PER_THREAD ? count - TRACE_EVENTS_PER_THREAD : 0;
+        dropped += oldest;
+        for (uint64_t i = oldest; i < count; ++i) {
+            const TraceEvent& event = trace->events[i & (TRACE_EVENTS_PER_THREAD - 1)];
+            fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+            writeEscaped(file, event.name);
+            fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                trace->threadId,
+                event.start / 1000.0,
+                (event.end - event.start) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\"otherData\":{\"droppedEvents\":%llu}}\n",
+        static_cast<unsigned long long>(dropped));
+    return fclose(file) == 0;
+}
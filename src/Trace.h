@@ -0,0 +1,62 @@
+#ifndef HAMON_TRACE_H__
+#define HAMON_TRACE_H__
+#include <stdint.h>
+
+// CPU trace zones. Every thread records into its own fixed size ring, no
+// locks on the recording path; once it is full the oldest events are
+// overwritten, so a long session keeps its last frames. Build with
+// HAMON_ENABLE_TRACING=0 to compile the zones out entirely.
+//
+//     void Renderer::frameEnd()
+//     {
+//         HAMON_TRACE_SCOPE("submit");
+//         ...
+//     }
+//
+// writeChromeTrace() dumps the events as Chrome trace_event JSON, which
+// chrome://tracing and Perfetto open directly. The overwritten events are
+// counted in otherData.droppedEvents.
+
+#ifndef HAMON_ENABLE_TRACING
+#define HAMON_ENABLE_TRACING 1
+#endif
+
+// a power of two
+const uint32_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+// nanoseconds since the first call, monotonic
+uint64_t traceNow();
+
+// name must outlive the trace (string literals)
+void traceRecord(const char* name, uint64_t startNs, uint64_t endNs);
+
+// shows up as the thread's track name in the viewer
+void traceSetThreadName(const char* name);
+
+// Not synchronized with recording threads beyond seeing every event that
+// was complete when it started, call it once the frame loop stopped.
+bool writeChromeTrace(const char* path);
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), start_(traceNow()) {}
+    ~TraceScope() { traceRecord(name_, start_, traceNow()); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+#define HAMON_TRACE_CONCAT_(a, b) a##b
+#define HAMON_TRACE_CONCAT(a, b) HAMON_TRACE_CONCAT_(a, b)
+
+#if HAMON_ENABLE_TRACING
+#define HAMON_TRACE_SCOPE(name) TraceScope HAMON_TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define HAMON_TRACE_THREAD_NAME(name) traceSetThreadName(name)
+#else
+#define HAMON_TRACE_SCOPE(name) do {} while (0)
+#define HAMON_TRACE_THREAD_NAME(name) do {} while (0)
+#endif
+
+#endif
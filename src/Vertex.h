@@ -3,12 +3,10 @@
 #include <array>
 #include <glm/glm.hpp>
 
-struct UniformBufferObject{
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
-    // TODO:
-    // glm::mat4 mvp;
+// per draw, push constants of the vertex (or mesh) stage. The CPU batches
+// the products for every visible object, vertices only do one transform.
+struct DrawConstants {
+    glm::mat4 mvp;
 };
 
 struct Vertex {
@@ -26,9 +24,9 @@ struct Vertex {
         return bindingDescription;
     }
 
-    static std::vector<VkVertexInputAttributeDescription> getAttributeDescription()
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescription()
     {
-        std::vector<VkVertexInputAttributeDescription> attributes(3);
+        std::array<VkVertexInputAttributeDescription, 3> attributes = {};
         attributes[0].binding = 0;
         attributes[0].location = 0;
         attributes[0].format= VK_FORMAT_R32G32B32_SFLOAT;
@@ -59,7 +57,7 @@ static const std::vector<Vertex> vertices = {
     {{-0.5f, 0.5f,  -0.5f}, {1.0f, 1.0f, 1.0f}, {0.f , 1.f}}
 };
 
-static const std::vector<uint16_t> indices = {
+static const std::vector<uint32_t> indices = {
     0, 1, 2, 2, 3, 0,
     4, 5, 6, 6, 7, 4
 };
\ No newline at end of file
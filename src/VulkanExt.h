@@ -0,0 +1,51 @@
+#ifndef HAMON_VULKAN_EXT_H__
+#define HAMON_VULKAN_EXT_H__
+#include "vulkan.h"
+
+// vulkan.h is generated by glad with a fixed extension list, declarations for
+// optional device extensions that are not part of it live here. Their entry
+// points are not loaded by glad, fetch them with vkGetDeviceProcAddr.
+
+#ifndef VK_EXT_mesh_shader
+#define VK_EXT_mesh_shader 1
+#define VK_EXT_MESH_SHADER_EXTENSION_NAME "VK_EXT_mesh_shader"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT ((VkStructureType)1000328000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT ((VkStructureType)1000328001)
+#define VK_SHADER_STAGE_TASK_BIT_EXT ((VkShaderStageFlagBits)0x00000040)
+#define VK_SHADER_STAGE_MESH_BIT_EXT ((VkShaderStageFlagBits)0x00000080)
+#define VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT ((VkPipelineStageFlagBits)0x00080000)
+#define VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT ((VkPipelineStageFlagBits)0x00100000)
+
+typedef struct VkPhysicalDeviceMeshShaderFeaturesEXT {
+    VkStructureType sType;
+    void*           pNext;
+    VkBool32        taskShader;
+    VkBool32        meshShader;
+    VkBool32        multiviewMeshShader;
+    VkBool32        primitiveFragmentShadingRateMeshShader;
+    VkBool32        meshShaderQueries;
+} VkPhysicalDeviceMeshShaderFeaturesEXT;
+
+typedef void (VKAPI_PTR *PFN_vkCmdDrawMeshTasksEXT)(VkCommandBuffer commandBuffer,
+    uint32_t groupCountX,
+    uint32_t groupCountY,
+    uint32_t groupCountZ);
+#endif
+
+#ifndef VK_EXT_memory_budget
+#define VK_EXT_memory_budget 1
+#define VK_EXT_MEMORY_BUDGET_EXTENSION_NAME "VK_EXT_memory_budget"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT ((VkStructureType)1000237000)
+
+// chained to VkPhysicalDeviceMemoryProperties2
+typedef struct VkPhysicalDeviceMemoryBudgetPropertiesEXT {
+    VkStructureType sType;
+    void*           pNext;
+    VkDeviceSize    heapBudget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize    heapUsage[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryBudgetPropertiesEXT;
+#endif
+
+#endif
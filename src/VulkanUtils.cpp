@@ -2,8 +2,11 @@
 #include "vulkan.h"
 #include <iostream>
 #include <algorithm>
+#include <string.h>
 #include "IoUtils.h"
 #include "Vertex.h"
+#include "VulkanExt.h"
+#include "Trace.h"
 
 bool checkRequireExtensions(const std::vector<const char*>& requiredExtensions)
 {
@@ -127,10 +130,25 @@ VkPhysicalDevice getPhysicalDevice(VkInstance instance)
     return physicalDevices[0];
 }
 
+bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice, const char* extension)
+{
+    uint32_t extensionCount = 0;
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr));
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    VK_CHECK(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()));
+    for (const auto& properties : extensions) {
+        if (strcmp(properties.extensionName, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 VkDevice createDevice(VkPhysicalDevice physicalDevice, 
     VkSurfaceKHR surface,
     uint32_t& graphicsQueueFamilyIndex,
-    uint32_t& presentQueueFamilyIndex)
+    uint32_t& presentQueueFamilyIndex,
+    DeviceCapabilities* capabilities)
 {
     VkQueueFamilyProperties familyProperties[16];
     uint32_t queueFamilyCount = sizeof(familyProperties)/ sizeof(familyProperties[0]);
@@ -141,7 +159,13 @@ VkDevice createDevice(VkPhysicalDevice physicalDevice,
     for (uint32_t queueFamilyIndex = 0; queueFamilyIndex < queueFamilyCount; ++queueFamilyIndex) {
         VkQueueFamilyProperties queueFamily = familyProperties[queueFamilyIndex];
         VkBool32 presentSupported = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIndex, surface, &presentSupported);
+        // headless: nothing to present, the graphics queue does it all
+        if (surface == VK_NULL_HANDLE) {
+            presentSupported = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) == VK_QUEUE_GRAPHICS_BIT;
+        }
+        else {
+            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamilyIndex, surface, &presentSupported);
+        }
         if (presentSupported) 
         {
             presentQueueFamilyIndex = queueFamilyIndex;
@@ -163,24 +187,100 @@ VkDevice createDevice(VkPhysicalDevice physicalDevice,
     queueInfo.queueFamilyIndex = grahicsQueueFamilyIndex;
     queueInfo.flags = 0;
 
-    const char* deviceExtension[] = {
-        "VK_KHR_swapchain",
-    };
+    // the swapchain extension needs VK_KHR_surface on the instance, which
+    // headless instances don't enable
+    std::vector<const char*> deviceExtension;
+    if (surface != VK_NULL_HANDLE) {
+        deviceExtension.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    DeviceCapabilities enabled;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    // mesh shaders need SPIR-V 1.4, which is core in 1.2
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    if (properties.apiVersion >= VK_API_VERSION_1_2 &&
+        checkDeviceExtensionSupport(physicalDevice, VK_EXT_MESH_SHADER_EXTENSION_NAME))
+    {
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &meshShaderFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        enabled.meshShader = meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+    }
+    void* featureChain = nullptr;
+    if (enabled.meshShader) {
+        meshShaderFeatures = {};
+        meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+        meshShaderFeatures.pNext = featureChain;
+        meshShaderFeatures.taskShader = VK_TRUE;
+        meshShaderFeatures.meshShader = VK_TRUE;
+        featureChain = &meshShaderFeatures;
+        deviceExtension.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+
+    // core in 1.2 and 1.3, no extension to enable
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceSynchronization2Features synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    if (properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &timelineFeatures;
+        if (properties.apiVersion >= VK_API_VERSION_1_3) {
+            timelineFeatures.pNext = &synchronization2Features;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        enabled.timelineSemaphore = timelineFeatures.timelineSemaphore == VK_TRUE;
+        enabled.synchronization2 = synchronization2Features.synchronization2 == VK_TRUE;
+    }
+    if (enabled.timelineSemaphore) {
+        timelineFeatures = {};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timelineFeatures.pNext = featureChain;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        featureChain = &timelineFeatures;
+    }
+    if (enabled.synchronization2) {
+        synchronization2Features = {};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+        synchronization2Features.pNext = featureChain;
+        synchronization2Features.synchronization2 = VK_TRUE;
+        featureChain = &synchronization2Features;
+    }
+
+    if (properties.apiVersion >= VK_API_VERSION_1_1 &&
+        checkDeviceExtensionSupport(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+    {
+        enabled.memoryBudget = true;
+        deviceExtension.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    VkPhysicalDeviceFeatures supportedFeatures = {};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    enabled.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    enabled.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
 
     VkPhysicalDeviceFeatures features={};
     features.samplerAnisotropy = VK_TRUE;
-    VkPhysicalDeviceFeatures deviceFeatures ={};
+    features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
     VkDeviceCreateInfo deviceInfo ={};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceInfo.pNext = nullptr;
+    deviceInfo.pNext = featureChain;
     deviceInfo.pQueueCreateInfos = &queueInfo;
     deviceInfo.queueCreateInfoCount = 1;
-    deviceInfo.pEnabledFeatures = &deviceFeatures;
-    deviceInfo.enabledExtensionCount = sizeof(deviceExtension)/sizeof(deviceExtension[0]);
-    deviceInfo.ppEnabledExtensionNames = deviceExtension;
+    deviceInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtension.size());
+    deviceInfo.ppEnabledExtensionNames = deviceExtension.data();
     deviceInfo.pEnabledFeatures = &features;
     VkDevice device{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device));
+    VK_CHECK(vkCreateDevice(physicalDevice, &deviceInfo, hostAllocator(), &device));
+    if (capabilities) {
+        *capabilities = enabled;
+    }
     return device ;
 }
 
@@ -222,7 +322,7 @@ VkSwapchainKHR createSwapchain(VkPhysicalDevice physicalDevice,
     swapchainInfo.preTransform = details.capabilities.currentTransform;
     swapchainInfo.clipped = VK_TRUE;
     VkSwapchainKHR swapchain{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateSwapchainKHR(device, &swapchainInfo, nullptr, &swapchain));
+    VK_CHECK(vkCreateSwapchainKHR(device, &swapchainInfo, hostAllocator(), &swapchain));
     return swapchain;
 }
 
@@ -230,7 +330,8 @@ VkImageView createImageView(VkDevice device,
     VkImage image,
     VkImageViewType viewType,
     VkImageAspectFlags aspectFlag, 
-    VkFormat format)
+    VkFormat format,
+    uint32_t levelCount)
 {
     VkImageViewCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -247,22 +348,24 @@ VkImageView createImageView(VkDevice device,
     info.subresourceRange.baseArrayLayer = 0;
     info.subresourceRange.baseMipLevel = 0;
     info.subresourceRange.layerCount = 1;
-    info.subresourceRange.levelCount = 1;
+    info.subresourceRange.levelCount = levelCount;
     VkImageView imageView{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateImageView(device, &info, nullptr, &imageView));
+    VK_CHECK(vkCreateImageView(device, &info, hostAllocator(), &imageView));
     return imageView;
 }
 
 
 VkImageView createImageView2D(VkDevice device, VkImage image, 
     VkImageAspectFlags aspectFlag, 
-    VkFormat format)
+    VkFormat format,
+    uint32_t levelCount)
 {
     return createImageView(device, 
         image, 
         VK_IMAGE_VIEW_TYPE_2D, 
         aspectFlag,
-        format);
+        format,
+        levelCount);
 }
 
 VkSampler createSampler(VkDevice device)
@@ -283,10 +386,11 @@ VkSampler createSampler(VkDevice device)
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.f;
     samplerInfo.minLod = 0.f;
-    samplerInfo.maxLod = 0.f;
+    // views decide how many mips there are
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     VkSampler sampler {VK_NULL_HANDLE};
-    VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &sampler));
+    VK_CHECK(vkCreateSampler(device, &samplerInfo, hostAllocator(), &sampler));
     return sampler;
 }
 
@@ -298,7 +402,7 @@ VkCommandPool createCommandPool(VkDevice device, uint32_t queueFamilyIndex)
     info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     info.queueFamilyIndex = queueFamilyIndex;
     VkCommandPool commandPool{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateCommandPool(device, &info, nullptr, &commandPool));
+    VK_CHECK(vkCreateCommandPool(device, &info, hostAllocator(), &commandPool));
     return commandPool;
 }
 
@@ -309,23 +413,42 @@ VkSemaphore createSemaphore(VkDevice device)
     info.pNext = nullptr;
     info.flags = 0;
     VkSemaphore semaphore{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateSemaphore(device, &info, nullptr, &semaphore));
+    VK_CHECK(vkCreateSemaphore(device, &info, hostAllocator(), &semaphore));
+    return semaphore;
+}
+
+VkSemaphore createTimelineSemaphore(VkDevice device, uint64_t initialValue)
+{
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.pNext = nullptr;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initialValue;
+
+    VkSemaphoreCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    info.pNext = &typeInfo;
+    info.flags = 0;
+    VkSemaphore semaphore{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateSemaphore(device, &info, hostAllocator(), &semaphore));
     return semaphore;
 }
 
 VkPipelineLayout createPipelineLayout(VkDevice device,
     VkDescriptorSetLayout* descriptorSetLayout, 
-    uint32_t descriptorSetLayoutSize)
+    uint32_t descriptorSetLayoutSize,
+    const VkPushConstantRange* pushConstantRanges,
+    uint32_t pushConstantRangeSize)
 {
     VkPipelineLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     layoutInfo.pNext = nullptr;
     layoutInfo.setLayoutCount = descriptorSetLayoutSize;
     layoutInfo.pSetLayouts = descriptorSetLayout;
-    layoutInfo.pushConstantRangeCount = 0;
-    layoutInfo.pPushConstantRanges= nullptr;
+    layoutInfo.pushConstantRangeCount = pushConstantRangeSize;
+    layoutInfo.pPushConstantRanges= pushConstantRanges;
     VkPipelineLayout pipelineLayout;
-    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout));
+    VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, hostAllocator(), &pipelineLayout));
     return pipelineLayout;
 }
 
@@ -338,7 +461,7 @@ VkShaderModule createShaderModule(VkDevice device, const char* spvPath)
     info.pCode = reinterpret_cast<uint32_t*>(spv.data());
     info.codeSize = static_cast<uint32_t>(spv.size());
     VkShaderModule shaderModule {VK_NULL_HANDLE};
-    VK_CHECK(vkCreateShaderModule(device, &info, nullptr, &shaderModule));
+    VK_CHECK(vkCreateShaderModule(device, &info, hostAllocator(), &shaderModule));
     return shaderModule;
 }
 
@@ -354,8 +477,10 @@ VkRenderPass createRenderPass(VkDevice device,
     attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // layout transitions and synchronization around the pass come from the
+    // render graph
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     attachments[1].format = depthFormat;
     attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -364,7 +489,7 @@ VkRenderPass createRenderPass(VkDevice device,
     attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     // 
@@ -382,15 +507,6 @@ VkRenderPass createRenderPass(VkDevice device,
     subpassDescription.pDepthStencilAttachment = &depthAttachmentReferences;
     subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
-    // 呈现
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
     VkRenderPassCreateInfo passInfo = {};
     passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     passInfo.flags = 0;
@@ -399,37 +515,47 @@ VkRenderPass createRenderPass(VkDevice device,
     passInfo.pAttachments = attachments;
     passInfo.subpassCount = 1;
     passInfo.pSubpasses = &subpassDescription;
-    passInfo.dependencyCount =1;
-    passInfo.pDependencies= &dependency;
+    passInfo.dependencyCount = 0;
+    passInfo.pDependencies = nullptr;
 
     VkRenderPass renderPass{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateRenderPass(device, &passInfo, nullptr, &renderPass));
+    VK_CHECK(vkCreateRenderPass(device, &passInfo, hostAllocator(), &renderPass));
     return renderPass;
 }
 
 
-VkPipeline createGraphicsPipeline(VkDevice device, 
-    VkPipelineLayout pipelineLayout,
-    VkRenderPass renderPass,
-    VkShaderModule vertShaderModule, 
-    VkShaderModule fragShaderModule,
-    uint32_t width,
-    uint32_t height)
+VkPipeline createGraphicsPipeline(VkDevice device,
+    const GraphicsPipelineDesc& desc,
+    VkPipelineCache pipelineCache)
 {
+    VkSpecializationMapEntry specializationEntries[MAX_PIPELINE_SPECIALIZATION_CONSTANTS];
+    for (uint32_t i = 0; i < desc.specializationCount; ++i) {
+        specializationEntries[i].constantID = i;
+        specializationEntries[i].offset = i * sizeof(uint32_t);
+        specializationEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = desc.specializationCount;
+    specializationInfo.pMapEntries = specializationEntries;
+    specializationInfo.dataSize = desc.specializationCount * sizeof(uint32_t);
+    specializationInfo.pData = desc.specialization;
+    const VkSpecializationInfo* specialization =
+        desc.specializationCount > 0 ? &specializationInfo : nullptr;
+
     VkPipelineShaderStageCreateInfo shaderStages[2]{};
     shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[0].flags = 0;
-    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].module = desc.vertexShader;
     shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
     shaderStages[0].pName = "main";
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = specialization;
 
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].flags = 0;
-    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].module = desc.fragmentShader;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     shaderStages[1].pName = "main";
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo = specialization;
 
     VkVertexInputBindingDescription bindingDescription = Vertex::getVertexBindingDescription();
     auto attributes = Vertex::getAttributeDescription();
@@ -437,34 +563,24 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.flags = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-    vertexInputInfo.vertexAttributeDescriptionCount = attributes.size();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    if (desc.vertexLayout == VERTEX_LAYOUT_STANDARD) {
+        vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = attributes.size();
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    }
     // 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly ={};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.pNext = nullptr;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.topology = static_cast<VkPrimitiveTopology>(desc.topology);
 
     VkDynamicState dynamicStates [] ={
         VK_DYNAMIC_STATE_VIEWPORT,
         VK_DYNAMIC_STATE_SCISSOR,
     };
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)width;
-    viewport.height = (float)height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = {width, height};
-
     VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
     dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
     dynamicStateInfo.flags = 0;
@@ -475,9 +591,7 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
 
 
     VkPipelineRasterizationStateCreateInfo rasterizationState ={};
@@ -487,9 +601,9 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     rasterizationState.rasterizerDiscardEnable = VK_FALSE ;
     rasterizationState.depthBiasEnable = VK_FALSE;
     rasterizationState.depthClampEnable = VK_FALSE;
-    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationState.polygonMode = static_cast<VkPolygonMode>(desc.polygonMode);
+    rasterizationState.cullMode = desc.cullMode;
+    rasterizationState.frontFace = static_cast<VkFrontFace>(desc.frontFace);
     rasterizationState.lineWidth = 1.f;
     rasterizationState.depthBiasConstantFactor = 0.f;
     rasterizationState.depthBiasClamp = 0.f;
@@ -508,9 +622,9 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     VkPipelineDepthStencilStateCreateInfo depthStencilInfo ={};
     depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
     depthStencilInfo.pNext = nullptr;
-    depthStencilInfo.depthTestEnable = VK_TRUE;
-    depthStencilInfo.depthWriteEnable = VK_TRUE;
-    depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilInfo.depthTestEnable = desc.depthTest;
+    depthStencilInfo.depthWriteEnable = desc.depthWrite;
+    depthStencilInfo.depthCompareOp = static_cast<VkCompareOp>(desc.depthCompareOp);
     depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
     depthStencilInfo.minDepthBounds = 0;
     depthStencilInfo.maxDepthBounds = 1.f;
@@ -519,8 +633,7 @@ VkPipeline createGraphicsPipeline(VkDevice device,
 
     //
     VkPipelineColorBlendAttachmentState colorBlendAttachment= {};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-        VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.colorWriteMask = desc.colorWriteMask;
     colorBlendAttachment.blendEnable = VK_FALSE;
     colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
     colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -528,8 +641,18 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
     colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
     colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-        VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    if (desc.blendMode == BLEND_MODE_ALPHA) {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    }
+    else if (desc.blendMode == BLEND_MODE_ADDITIVE) {
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    }
 
     VkPipelineColorBlendStateCreateInfo colorBlendInfo ={};
     colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -558,10 +681,104 @@ VkPipeline createGraphicsPipeline(VkDevice device,
     graphicsPipelineInfo.pColorBlendState = &colorBlendInfo;
     graphicsPipelineInfo.pDynamicState = &dynamicStateInfo;
     graphicsPipelineInfo.pDepthStencilState = &depthStencilInfo;
+    graphicsPipelineInfo.layout = desc.layout;
+    graphicsPipelineInfo.renderPass = desc.renderPass;
+    graphicsPipelineInfo.subpass = desc.subpass;
+    graphicsPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    graphicsPipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline graphicsPipeline{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateGraphicsPipelines(device, 
+        pipelineCache, 
+        1, 
+        &graphicsPipelineInfo, 
+        hostAllocator(), 
+        &graphicsPipeline));
+
+    return graphicsPipeline;
+}
+
+VkPipeline createMeshShaderPipeline(VkDevice device,
+    VkPipelineLayout pipelineLayout,
+    VkRenderPass renderPass,
+    VkShaderModule taskShaderModule,
+    VkShaderModule meshShaderModule,
+    VkShaderModule fragShaderModule)
+{
+    VkPipelineShaderStageCreateInfo shaderStages[3]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].module = taskShaderModule;
+    shaderStages[0].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+    shaderStages[0].pName = "main";
+
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].module = meshShaderModule;
+    shaderStages[1].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+    shaderStages[1].pName = "main";
+
+    shaderStages[2].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[2].module = fragShaderModule;
+    shaderStages[2].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[2].pName = "main";
+
+    VkDynamicState dynamicStates [] ={
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+    dynamicStateInfo.dynamicStateCount = ARRAY_SIZE(dynamicStates);
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState ={};
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationState.lineWidth = 1.f;
+
+    VkPipelineMultisampleStateCreateInfo multisamplingInfo ={};
+    multisamplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisamplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisamplingInfo.minSampleShading = 1.f;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo ={};
+    depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilInfo.depthTestEnable = VK_TRUE;
+    depthStencilInfo.depthWriteEnable = VK_TRUE;
+    depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilInfo.maxDepthBounds = 1.f;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment= {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+        VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo ={};
+    colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
+    colorBlendInfo.attachmentCount =1;
+    colorBlendInfo.pAttachments  =&colorBlendAttachment;
+
+    // no vertex input / input assembly state, the mesh shader emits primitives
+    VkGraphicsPipelineCreateInfo graphicsPipelineInfo = {};
+    graphicsPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    graphicsPipelineInfo.stageCount= ARRAY_SIZE(shaderStages);
+    graphicsPipelineInfo.pStages = shaderStages;
+    graphicsPipelineInfo.pViewportState = &viewportState;
+    graphicsPipelineInfo.pRasterizationState = &rasterizationState;
+    graphicsPipelineInfo.pMultisampleState = &multisamplingInfo;
+    graphicsPipelineInfo.pColorBlendState = &colorBlendInfo;
+    graphicsPipelineInfo.pDynamicState = &dynamicStateInfo;
+    graphicsPipelineInfo.pDepthStencilState = &depthStencilInfo;
     graphicsPipelineInfo.layout = pipelineLayout;
     graphicsPipelineInfo.renderPass = renderPass;
     graphicsPipelineInfo.subpass = 0;
-    graphicsPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineInfo.basePipelineIndex = -1;
 
     VkPipeline graphicsPipeline{VK_NULL_HANDLE};
@@ -569,12 +786,38 @@ VkPipeline createGraphicsPipeline(VkDevice device,
         VK_NULL_HANDLE, 
         1, 
         &graphicsPipelineInfo, 
-        nullptr, 
+        hostAllocator(), 
         &graphicsPipeline));
-
     return graphicsPipeline;
 }
 
+VkPipeline createComputePipeline(VkDevice device,
+    VkPipelineLayout pipelineLayout,
+    VkShaderModule computeShaderModule)
+{
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = nullptr;
+    pipelineInfo.flags = 0;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = computeShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = nullptr;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline computePipeline{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateComputePipelines(device, 
+        VK_NULL_HANDLE, 
+        1, 
+        &pipelineInfo, 
+        hostAllocator(), 
+        &computePipeline));
+    return computePipeline;
+}
+
 VkFramebuffer createFrambuffer(VkDevice device,
     VkRenderPass renderPass,
     VkExtent2D extent,
@@ -592,7 +835,7 @@ VkFramebuffer createFrambuffer(VkDevice device,
     framebufferInfo.width = extent.width;
     framebufferInfo.height = extent.height;
     VkFramebuffer framebuffer {VK_NULL_HANDLE};
-    VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer));
+    VK_CHECK(vkCreateFramebuffer(device, &framebufferInfo, hostAllocator(), &framebuffer));
     return framebuffer;
 }
 
@@ -617,10 +860,27 @@ VkFence createFence(VkDevice device)
     fenceInfo.pNext = nullptr;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     VkFence fence{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &fence));
+    VK_CHECK(vkCreateFence(device, &fenceInfo, hostAllocator(), &fence));
     return fence;
 }
 
+VkQueryPool createQueryPool(VkDevice device,
+    VkQueryType queryType,
+    uint32_t queryCount,
+    VkQueryPipelineStatisticFlags pipelineStatistics)
+{
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.pNext = nullptr;
+    queryPoolInfo.flags = 0;
+    queryPoolInfo.queryType = queryType;
+    queryPoolInfo.queryCount = queryCount;
+    queryPoolInfo.pipelineStatistics = pipelineStatistics;
+    VkQueryPool queryPool{VK_NULL_HANDLE};
+    VK_CHECK(vkCreateQueryPool(device, &queryPoolInfo, hostAllocator(), &queryPool));
+    return queryPool;
+}
+
 VkBuffer createBuffer(VkDevice device, 
     VkBufferUsageFlags usage,
     size_t size)
@@ -633,14 +893,15 @@ VkBuffer createBuffer(VkDevice device,
     bufferInfo.pQueueFamilyIndices = nullptr;
     bufferInfo.queueFamilyIndexCount = 0;
     VkBuffer buffer{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
+    VK_CHECK(vkCreateBuffer(device, &bufferInfo, hostAllocator(), &buffer));
     return buffer;
 }
 
 VkDeviceMemory createBufferMemory(VkDevice device, 
     VkBuffer buffer,
     VkPhysicalDeviceMemoryProperties memoryProperties,
-    VkMemoryPropertyFlags memoryPropertyFlags)
+    VkMemoryPropertyFlags memoryPropertyFlags,
+    MemoryAllocation* allocation)
 {
     VkMemoryRequirements memoryRequirements ={};
     vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
@@ -651,14 +912,19 @@ VkDeviceMemory createBufferMemory(VkDevice device,
         memoryPropertyFlags);
     allocInfo.allocationSize = memoryRequirements.size;
     VkDeviceMemory deviceMemory {VK_NULL_HANDLE};
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &deviceMemory));
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, hostAllocator(), &deviceMemory));
+    if (allocation) {
+        allocation->size = allocInfo.allocationSize;
+        allocation->memoryTypeIndex = allocInfo.memoryTypeIndex;
+    }
     return deviceMemory;
 }
 
 VkDeviceMemory createImageMemory(VkDevice device,
     VkImage image, 
     VkPhysicalDeviceMemoryProperties memoryProperties,
-    VkMemoryPropertyFlags memoryPropertyFlags)
+    VkMemoryPropertyFlags memoryPropertyFlags,
+    MemoryAllocation* allocation)
 {
     VkMemoryRequirements memoryRequirements ={};
     vkGetImageMemoryRequirements(device, image, &memoryRequirements);
@@ -669,7 +935,11 @@ VkDeviceMemory createImageMemory(VkDevice device,
         memoryPropertyFlags);
     allocInfo.allocationSize = memoryRequirements.size;
     VkDeviceMemory deviceMemory {VK_NULL_HANDLE};
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &deviceMemory));
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, hostAllocator(), &deviceMemory));
+    if (allocation) {
+        allocation->size = allocInfo.allocationSize;
+        allocation->memoryTypeIndex = allocInfo.memoryTypeIndex;
+    }
     return deviceMemory;
 }
 
@@ -688,7 +958,7 @@ void createBufferWithMemory(VkDevice device,
     bufferInfo.usage = bufferUsage;
     bufferInfo.pQueueFamilyIndices = nullptr;
     bufferInfo.queueFamilyIndexCount = 0;
-    VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, buffer));
+    VK_CHECK(vkCreateBuffer(device, &bufferInfo, hostAllocator(), buffer));
 
     VkMemoryRequirements memoryRequirements = {};
     vkGetBufferMemoryRequirements(device, *buffer, &memoryRequirements);
@@ -699,7 +969,7 @@ void createBufferWithMemory(VkDevice device,
     allocInfo.memoryTypeIndex = findMemoryType(memoryProperties, memoryRequirements.memoryTypeBits, 
         memoryPropertyFlags);
     allocInfo.allocationSize = memoryRequirements.size;
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, bufferMemory));
+    VK_CHECK(vkAllocateMemory(device, &allocInfo, hostAllocator(), bufferMemory));
     vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
 }
 
@@ -738,13 +1008,15 @@ void copyBuffer(
     VkCommandPool commandPool,
     VkBuffer dstBuffer,
     VkBuffer srcBuffer,
-    VkDeviceSize size)
+    VkDeviceSize size,
+    VkDeviceSize dstOffset)
 {
+    HAMON_TRACE_SCOPE("copyBuffer");
     VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(device, commandPool);
     VkBufferCopy copyRegion;
     copyRegion.size = size;
     copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
+    copyRegion.dstOffset = dstOffset;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
     endSingleTimeCommandBuffer(device, queue, commandPool,commandBuffer);
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
@@ -781,21 +1053,23 @@ void endSingleTimeCommandBuffer(
 
 VkDescriptorPool createDescriptorPool(VkDevice device)
 {
-    VkDescriptorPoolSize poolSize[2];
-    poolSize[0].descriptorCount = 128;
+    VkDescriptorPoolSize poolSize[3];
+    poolSize[0].descriptorCount = 1024;
     poolSize[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize[1].descriptorCount = 128;
+    poolSize[1].descriptorCount = 1024;
     poolSize[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize[2].descriptorCount = 128;
+    poolSize[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.pNext = nullptr;
     poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT ;
-    poolInfo.maxSets = 512;
-    poolInfo.poolSizeCount =2;
+    poolInfo.maxSets = 1024;
+    poolInfo.poolSizeCount = ARRAY_SIZE(poolSize);
     poolInfo.pPoolSizes = poolSize;
     VkDescriptorPool pool{VK_NULL_HANDLE};
-    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool));
+    VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, hostAllocator(), &pool));
     return pool;
 }
 
@@ -809,7 +1083,7 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device,
     descriptorSetInfo.pBindings = bindings;
     descriptorSetInfo.bindingCount = bindingSize;
     VkDescriptorSetLayout descriptorSetLayout ={VK_NULL_HANDLE};
-    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetInfo, nullptr, &descriptorSetLayout));
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &descriptorSetInfo, hostAllocator(), &descriptorSetLayout));
     return descriptorSetLayout;
 }
 
@@ -842,7 +1116,7 @@ static VkImage createImage(
     imageInfo.usage = usage;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     VkImage image = {VK_NULL_HANDLE};
-    VK_CHECK(vkCreateImage(device, &imageInfo, nullptr, &image));
+    VK_CHECK(vkCreateImage(device, &imageInfo, hostAllocator(), &image));
     return image;
 }
 
@@ -876,79 +1150,6 @@ bool hasStencilComponent(VkFormat format)
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void transitionImageLayout(VkDevice device,
-    VkQueue queue,
-    VkCommandPool commandPool,
-    VkImage image,
-    VkFormat format,
-    VkImageLayout oldLayout,
-    VkImageLayout newLayout)
-{
-    VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(device, commandPool);
-
-    VkImageMemoryBarrier imageBarrier ={};
-    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageBarrier.pNext = nullptr;
-    imageBarrier.oldLayout = oldLayout;
-    imageBarrier.newLayout = newLayout;
-
-    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-    imageBarrier.image= image;
-
-    imageBarrier.subresourceRange.baseMipLevel = 0;
-    imageBarrier.subresourceRange.levelCount = 1;
-    imageBarrier.subresourceRange.baseArrayLayer = 0;
-    imageBarrier.subresourceRange.layerCount = 1;
-    if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) 
-    {
-        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        if (hasStencilComponent(format))
-        {
-            imageBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-    } else {
-        imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
-    
-    VkPipelineStageFlags srcStage;
-    VkPipelineStageFlags dstStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-    {
-        imageBarrier.srcAccessMask = 0;
-        imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if(oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&  newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else if(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-    {
-        imageBarrier.srcAccessMask = 0;
-        imageBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | 
-            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    }
-    vkCmdPipelineBarrier(commandBuffer, 
-        srcStage,
-        dstStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1,  &imageBarrier);
-
-    endSingleTimeCommandBuffer(device,queue, commandPool, commandBuffer);
-}
-
 void copyBufferToImage(VkDevice device, 
     VkQueue queue,
     VkCommandPool commandPool,
@@ -957,6 +1158,7 @@ void copyBufferToImage(VkDevice device,
     uint32_t width,
     uint32_t height)
 {
+    HAMON_TRACE_SCOPE("copyBufferToImage");
     VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(device, commandPool);
 
     VkBufferImageCopy region = {};
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <GLFW/glfw3.h>
 #include "vulkan.h"
+#include "HostAllocator.h"
 #define VK_CHECK(call)                  \
     do{                                 \
         VkResult result = call;         \
@@ -40,6 +41,63 @@ struct SwapchainSettigs {
     VkPresentModeKHR presentMode;
 };
 
+// Optional device features, filled by createDevice with what was enabled
+struct DeviceCapabilities {
+    bool meshShader = false;
+    bool multiDrawIndirect = false;
+    bool pipelineStatisticsQuery = false;
+    // VK_EXT_memory_budget, usage / budget per heap from the driver
+    bool memoryBudget = false;
+    // Vulkan 1.2 timelineSemaphore feature
+    bool timelineSemaphore = false;
+    // Vulkan 1.3 synchronization2 feature, vkCmdPipelineBarrier2
+    bool synchronization2 = false;
+};
+
+enum VertexLayout {
+    // no vertex buffers, the shader generates its input
+    VERTEX_LAYOUT_NONE,
+    // Vertex from Vertex.h
+    VERTEX_LAYOUT_STANDARD,
+    VERTEX_LAYOUT_COUNT,
+};
+
+enum BlendMode {
+    BLEND_MODE_OPAQUE,
+    // src * srcAlpha + dst * (1 - srcAlpha)
+    BLEND_MODE_ALPHA,
+    BLEND_MODE_ADDITIVE,
+    BLEND_MODE_COUNT,
+};
+
+static const uint32_t MAX_PIPELINE_SPECIALIZATION_CONSTANTS = 8;
+
+// Everything a vertex + fragment pipeline is built from. Plain 32 and 64 bit
+// fields without padding so two descs can be hashed and compared as bytes;
+// the defaults are the opaque, depth tested state the scene is drawn with.
+struct GraphicsPipelineDesc {
+    VkShaderModule vertexShader = VK_NULL_HANDLE;
+    VkShaderModule fragmentShader = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    // pipelines work with every render pass compatible with this one
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    uint32_t vertexLayout = VERTEX_LAYOUT_STANDARD;
+    uint32_t topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    uint32_t polygonMode = VK_POLYGON_MODE_FILL;
+    uint32_t cullMode = VK_CULL_MODE_BACK_BIT;
+    uint32_t frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkBool32 depthTest = VK_TRUE;
+    VkBool32 depthWrite = VK_TRUE;
+    uint32_t depthCompareOp = VK_COMPARE_OP_LESS;
+    uint32_t blendMode = BLEND_MODE_OPAQUE;
+    uint32_t colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    // constant_id i of both stages is specialization[i], unused ones stay 0
+    uint32_t specializationCount = 0;
+    uint32_t specialization[MAX_PIPELINE_SPECIALIZATION_CONSTANTS] = {};
+};
+
 bool checkRequireExtensions(const std::vector<const char*>& requiredExtensions);
 bool checkRequiredLayerExtension(const std::vector<const char*>& requiredLayers);
 
@@ -48,10 +106,14 @@ SwapchainSupportDetails fetchSwapchainSupportDetails(VkPhysicalDevice physicalDe
     VkSurfaceKHR surface);
 SwapchainSettigs selectOptimalSwapchainSetting(const SwapchainSupportDetails& details);
 VkPhysicalDevice getPhysicalDevice(VkInstance instance);
+bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice, const char* extension);
+// surface may be VK_NULL_HANDLE for headless use, present then falls on the
+// graphics queue
 VkDevice createDevice(VkPhysicalDevice physicalDevice, 
     VkSurfaceKHR surface,
     uint32_t& graphicsQueueFamilyIndex,
-    uint32_t& presentQueueFamilyIndex);
+    uint32_t& presentQueueFamilyIndex,
+    DeviceCapabilities* capabilities = nullptr);
 
 VkSwapchainKHR createSwapchain(VkPhysicalDevice physicalDevice,
     VkDevice device, VkSurfaceKHR surface, 
@@ -63,17 +125,22 @@ VkSwapchainKHR createSwapchain(VkPhysicalDevice physicalDevice,
 VkImageView createImageView2D(VkDevice device, 
     VkImage image, 
     VkImageAspectFlags aspectFlag, 
-    VkFormat format);
+    VkFormat format,
+    uint32_t levelCount = 1);
 
 VkCommandPool createCommandPool(VkDevice device, uint32_t queueFamilyIndex);
 
 VkSemaphore createSemaphore(VkDevice device);
+// needs DeviceCapabilities::timelineSemaphore
+VkSemaphore createTimelineSemaphore(VkDevice device, uint64_t initialValue = 0);
 
 VkShaderModule createShaderModule(VkDevice device, const char* spvPath);
 
 VkPipelineLayout createPipelineLayout(VkDevice device, 
     VkDescriptorSetLayout* descriptorSetLayout, 
-    uint32_t descriptorSetLayoutSize);
+    uint32_t descriptorSetLayoutSize,
+    const VkPushConstantRange* pushConstantRanges = nullptr,
+    uint32_t pushConstantRangeSize = 0);
 
 VkRenderPass createRenderPass(VkDevice device, 
     VkFormat colorFormat,
@@ -88,34 +155,57 @@ VkFramebuffer createFrambuffer(VkDevice device,
     VkImageView *imageView,
     uint32_t numViewSize);
 
-VkPipeline createGraphicsPipeline(VkDevice device, 
+// viewport and scissor are dynamic
+VkPipeline createGraphicsPipeline(VkDevice device,
+    const GraphicsPipelineDesc& desc,
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+
+// task + mesh + fragment, requires DeviceCapabilities::meshShader
+VkPipeline createMeshShaderPipeline(VkDevice device,
     VkPipelineLayout pipelineLayout,
     VkRenderPass renderPass,
-    VkShaderModule vertShaderModule, 
-    VkShaderModule fragShaderModule,
-    uint32_t width,
-    uint32_t height);
+    VkShaderModule taskShaderModule,
+    VkShaderModule meshShaderModule,
+    VkShaderModule fragShaderModule);
+
+VkPipeline createComputePipeline(VkDevice device,
+    VkPipelineLayout pipelineLayout,
+    VkShaderModule computeShaderModule);
 
 VkCommandBuffer createCommandBuffer(VkDevice device, 
     VkCommandPool commandPool);
 
 VkFence createFence(VkDevice device);
 
+// pipelineStatistics is only used for VK_QUERY_TYPE_PIPELINE_STATISTICS
+VkQueryPool createQueryPool(VkDevice device,
+    VkQueryType queryType,
+    uint32_t queryCount,
+    VkQueryPipelineStatisticFlags pipelineStatistics = 0);
+
 VkDescriptorPool createDescriptorPool(VkDevice);
 
 VkBuffer createBuffer(VkDevice device, 
     VkBufferUsageFlags usage, 
     size_t size);
 
+// what vkAllocateMemory was asked for, for memory accounting
+struct MemoryAllocation {
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+};
+
 VkDeviceMemory createBufferMemory(VkDevice device,
     VkBuffer buffer, 
     VkPhysicalDeviceMemoryProperties memoryProperties,
-    VkMemoryPropertyFlags memoryPropertyFlags);
+    VkMemoryPropertyFlags memoryPropertyFlags,
+    MemoryAllocation* allocation = nullptr);
 
 VkDeviceMemory createImageMemory(VkDevice device,
     VkImage image, 
     VkPhysicalDeviceMemoryProperties memoryProperties,
-    VkMemoryPropertyFlags memoryPropertyFlags);
+    VkMemoryPropertyFlags memoryPropertyFlags,
+    MemoryAllocation* allocation = nullptr);
 
 void createBufferWithMemory(VkDevice device,
     VkBuffer* buffer,
@@ -167,7 +257,8 @@ void copyBuffer(
     VkCommandPool commandPool,
     VkBuffer dstBuffer,
     VkBuffer srcBuffer,
-    VkDeviceSize size);
+    VkDeviceSize size,
+    VkDeviceSize dstOffset = 0);
 
 void copyBufferToImage(VkDevice device, 
     VkQueue queue,
@@ -177,14 +268,6 @@ void copyBufferToImage(VkDevice device,
     uint32_t width,
     uint32_t height);
 
-void transitionImageLayout(VkDevice device,
-    VkQueue queue,
-    VkCommandPool commandPool,
-    VkImage image,
-    VkFormat format,
-    VkImageLayout oldLayout,
-    VkImageLayout newLayout);
-
 VkFormat selectOptimalSupportedFormat(
     VkPhysicalDevice physicalDevice,
     VkFormat* supportedFormats, 
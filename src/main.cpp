@@ -1,7 +1,9 @@
 #include "Application.h"
+#include "StartupTimeline.h"
 #include <iostream>
 #include <GLFW/glfw3.h>
 int main() {
+    beginStartup();
     if (!glfwInit()) {
         return EXIT_FAILURE;
     }